@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+
+#include "analysis.h"
+#include "pool.h"
+#include "watchdog.h"
+
+#define CHUNK_INTERVALS 512
+#define CHUNK_MAX_MARKERS 64
+#define MAX_ITERATIONS 60
+#define MAX_INTERVALS (1 << 24)
+#define MAX_GRID_INDEX 9007199254740992.0
+
+/* the grid is kept while the requested step stays within this factor */
+#define RESCAN_RATIO 2.0
+
+struct scan_chunk
+{
+    long long first;
+    int intervals;
+    int count;
+    struct marker found[CHUNK_MAX_MARKERS];
+};
+
+struct scan_job
+{
+    const struct jit_funcs *funcs;
+    double step;
+    struct scan_chunk *chunks;
+};
+
+static double eval_f(const struct jit_funcs *funcs, double x)
+{
+    return funcs->graph_func(x, funcs->time);
+}
+
+static double eval_df(const struct jit_funcs *funcs, double x)
+{
+    double dx;
+    funcs->graph_func_d(x, funcs->time, &dx);
+    return dx;
+}
+
+/* newton on f, falling back to bisection whenever a step leaves the bracket */
+static double refine_root(const struct jit_funcs *funcs, double lo, double hi, double flo)
+{
+    double tol = (hi - lo) * 1e-9;
+    double x = 0.5 * (lo + hi);
+
+    for (int i = 0; i < MAX_ITERATIONS; ++i)
+    {
+        double dfx;
+        double fx = funcs->graph_func_d(x, funcs->time, &dfx);
+        if (fx == 0)
+            return x;
+
+        if ((fx < 0) == (flo < 0))
+        {
+            lo = x;
+            flo = fx;
+        }
+        else
+            hi = x;
+
+        double next = x - fx / dfx;
+        if (!(next > lo && next < hi))
+            next = 0.5 * (lo + hi);
+
+        if (fabs(next - x) <= tol)
+            return next;
+        x = next;
+    }
+    return x;
+}
+
+/* brent's method on g, used for the zeros of f' where no f'' is available */
+static double refine_brent(double (*g)(const struct jit_funcs *, double), const struct jit_funcs *funcs,
+                           double a, double b, double fa, double fb)
+{
+    double tol = (b - a) * 1e-9;
+    double c = b, fc = fb;
+    double d = b - a, e = d;
+
+    for (int i = 0; i < MAX_ITERATIONS; ++i)
+    {
+        if ((fb > 0) == (fc > 0))
+        {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (fabs(fc) < fabs(fb))
+        {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        double tol1 = 2 * DBL_EPSILON * fabs(b) + 0.5 * tol;
+        double m = 0.5 * (c - b);
+        if (fabs(m) <= tol1 || fb == 0)
+            return b;
+
+        if (fabs(e) >= tol1 && fabs(fa) > fabs(fb))
+        {
+            /* inverse quadratic interpolation or secant */
+            double p, q, r, s = fb / fa;
+            if (a == c)
+            {
+                p = 2 * m * s;
+                q = 1 - s;
+            }
+            else
+            {
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+            if (p > 0)
+                q = -q;
+            else
+                p = -p;
+
+            if (2 * p < fmin(3 * m * q - fabs(tol1 * q), fabs(e * q)))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                d = m;
+                e = m;
+            }
+        }
+        else
+        {
+            d = m;
+            e = m;
+        }
+
+        a = b;
+        fa = fb;
+        b += fabs(d) > tol1 ? d : (m > 0 ? tol1 : -tol1);
+        fb = g(funcs, b);
+    }
+    return b;
+}
+
+static void add_found(struct scan_chunk *chunk, double x, double y, enum marker_kind kind)
+{
+    if (chunk->count < CHUNK_MAX_MARKERS)
+        chunk->found[chunk->count++] = (struct marker){x, y, kind};
+}
+
+static void scan_chunk(void *ctx, int index)
+{
+    struct scan_job *job = ctx;
+    struct scan_chunk *chunk = &job->chunks[index];
+    const struct jit_funcs *funcs = job->funcs;
+
+    if (watchdog_cancelled())
+        return;
+
+    double xa = chunk->first * job->step;
+    double da;
+    double fa = funcs->graph_func_d(xa, funcs->time, &da);
+    /* derivative one sample back, for extrema sitting exactly on the grid */
+    double dprev = eval_df(funcs, (chunk->first - 1) * job->step);
+
+    for (int i = 1; i <= chunk->intervals; ++i)
+    {
+        double xb = (chunk->first + i) * job->step;
+        double db;
+        double fb = funcs->graph_func_d(xb, funcs->time, &db);
+
+        if (isfinite(fa) && isfinite(fb))
+        {
+            if (fa == 0)
+                add_found(chunk, xa, 0, MARKER_ROOT);
+            else if ((fa < 0) != (fb < 0) && fb != 0)
+            {
+                double r = refine_root(funcs, xa, xb, fa);
+                double fr = eval_f(funcs, r);
+                /* a sign change across a pole gets larger, not smaller */
+                if (fabs(fr) <= fmin(fabs(fa), fabs(fb)))
+                    add_found(chunk, r, fr, MARKER_ROOT);
+            }
+        }
+
+        if (da == 0 && isfinite(fa) && dprev != 0 && db != 0 && (dprev < 0) != (db < 0))
+            add_found(chunk, xa, fa, dprev > 0 ? MARKER_MAX : MARKER_MIN);
+        else if (isfinite(da) && isfinite(db) && da != 0 && db != 0 && (da < 0) != (db < 0))
+        {
+            double r = refine_brent(eval_df, funcs, xa, xb, da, db);
+            double dr = eval_df(funcs, r);
+            double fr = eval_f(funcs, r);
+            if (isfinite(fr) && fabs(dr) <= fmin(fabs(da), fabs(db)))
+                add_found(chunk, r, fr, da > 0 ? MARKER_MAX : MARKER_MIN);
+        }
+
+        xa = xb;
+        fa = fb;
+        dprev = da;
+        da = db;
+    }
+}
+
+static void push_marker(struct analysis_cache *cache, struct marker m)
+{
+    if (cache->marker_count == cache->marker_capacity)
+    {
+        int capacity = cache->marker_capacity ? cache->marker_capacity * 2 : 64;
+        struct marker *grown = realloc(cache->markers, capacity * sizeof(*grown));
+        if (!grown)
+            return;
+        cache->markers = grown;
+        cache->marker_capacity = capacity;
+    }
+    cache->markers[cache->marker_count++] = m;
+}
+
+/*
+ * scans the intervals between samples lo and hi in parallel. false when
+ * the frame was cancelled part way, nothing is kept then.
+ */
+static bool scan(struct analysis_cache *cache, const struct jit_funcs *funcs, long long lo, long long hi)
+{
+    long long intervals = hi - lo;
+    if (intervals <= 0)
+        return true;
+
+    int chunk_count = (intervals + CHUNK_INTERVALS - 1) / CHUNK_INTERVALS;
+    struct scan_chunk *chunks = malloc(chunk_count * sizeof(*chunks));
+    if (!chunks)
+        return true;
+
+    for (int i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].first = lo + (long long)i * CHUNK_INTERVALS;
+        long long left = hi - chunks[i].first;
+        chunks[i].intervals = left < CHUNK_INTERVALS ? left : CHUNK_INTERVALS;
+        chunks[i].count = 0;
+    }
+
+    struct scan_job job = {funcs, cache->grid_step, chunks};
+    pool_for(chunk_count, scan_chunk, &job);
+
+    bool complete = !watchdog_cancelled();
+    for (int i = 0; complete && i < chunk_count; ++i)
+        for (int j = 0; j < chunks[i].count; ++j)
+            push_marker(cache, chunks[i].found[j]);
+
+    free(chunks);
+    return complete;
+}
+
+/* drops whatever lies outside the covered samples */
+static void trim_markers(struct analysis_cache *cache)
+{
+    double lo = cache->cov_lo * cache->grid_step;
+    double hi = cache->cov_hi * cache->grid_step;
+    int kept = 0;
+    for (int i = 0; i < cache->marker_count; ++i)
+    {
+        if (cache->markers[i].x >= lo && cache->markers[i].x <= hi)
+            cache->markers[kept++] = cache->markers[i];
+    }
+    cache->marker_count = kept;
+}
+
+void analysis_reset(struct analysis_cache *cache)
+{
+    cache->covered = false;
+    cache->marker_count = 0;
+}
+
+void analysis_free(struct analysis_cache *cache)
+{
+    free(cache->markers);
+    cache->markers = NULL;
+    cache->marker_count = cache->marker_capacity = 0;
+    cache->covered = false;
+}
+
+void analysis_update(struct analysis_cache *cache, const struct jit_funcs *funcs,
+                     double x_min, double x_max, double step)
+{
+    if (!(step > 0) || !(x_max > x_min))
+        return;
+
+    if (cache->covered &&
+        (step > cache->grid_step * RESCAN_RATIO || step < cache->grid_step / RESCAN_RATIO))
+        analysis_reset(cache);
+    if (!cache->covered)
+        cache->grid_step = step;
+
+    double need_lo_f = floor(x_min / cache->grid_step);
+    double need_hi_f = ceil(x_max / cache->grid_step);
+    /* past 2^53 grid indices no longer map to distinct samples (deep zoom) */
+    if (need_hi_f - need_lo_f > MAX_INTERVALS || !(fabs(need_lo_f) < MAX_GRID_INDEX) ||
+        !(fabs(need_hi_f) < MAX_GRID_INDEX))
+    {
+        analysis_reset(cache);
+        return;
+    }
+    long long need_lo = need_lo_f;
+    long long need_hi = need_hi_f;
+
+    if (cache->covered && (need_hi < cache->cov_lo || need_lo > cache->cov_hi))
+        analysis_reset(cache);
+
+    if (!cache->covered)
+    {
+        if (!scan(cache, funcs, need_lo, need_hi))
+            return;
+        cache->cov_lo = need_lo;
+        cache->cov_hi = need_hi;
+        cache->covered = true;
+        return;
+    }
+
+    if (need_lo < cache->cov_lo)
+    {
+        if (!scan(cache, funcs, need_lo, cache->cov_lo))
+            return;
+        cache->cov_lo = need_lo;
+    }
+    if (need_hi > cache->cov_hi)
+    {
+        if (!scan(cache, funcs, cache->cov_hi, need_hi))
+            return;
+        cache->cov_hi = need_hi;
+    }
+
+    /* keep one view width of history on either side for panning back */
+    long long span = need_hi - need_lo;
+    if (cache->cov_lo < need_lo - span || cache->cov_hi > need_hi + span)
+    {
+        if (cache->cov_lo < need_lo - span)
+            cache->cov_lo = need_lo - span;
+        if (cache->cov_hi > need_hi + span)
+            cache->cov_hi = need_hi + span;
+        trim_markers(cache);
+    }
+}
+
+int analysis_markers(const struct analysis_cache *cache, const struct marker **out)
+{
+    *out = cache->markers;
+    return cache->marker_count;
+}
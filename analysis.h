@@ -0,0 +1,52 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdbool.h>
+
+#include "jit.h"
+
+enum marker_kind
+{
+    MARKER_ROOT,
+    MARKER_MIN,
+    MARKER_MAX,
+};
+
+struct marker
+{
+    double x;
+    double y;
+    enum marker_kind kind;
+};
+
+/*
+ * markers found so far and the part of the x axis they were searched in,
+ * owned by whichever thread renders. zero initialize.
+ */
+struct analysis_cache
+{
+    struct marker *markers;
+    int marker_count, marker_capacity;
+
+    /* samples k * grid_step for k in [cov_lo, cov_hi] have been scanned */
+    bool covered;
+    double grid_step;
+    long long cov_lo, cov_hi;
+};
+
+/* forget everything found so far, call after the function changes */
+void analysis_reset(struct analysis_cache *cache);
+void analysis_free(struct analysis_cache *cache);
+
+/*
+ * finds roots and extrema of funcs in [x_min, x_max] by bracketing sign
+ * changes of f and f' on a grid of the given step and refining them.
+ * only the part of the range not covered by the previous call is scanned,
+ * so panning costs a strip the width of the pan.
+ */
+void analysis_update(struct analysis_cache *cache, const struct jit_funcs *funcs,
+                     double x_min, double x_max, double step);
+
+int analysis_markers(const struct analysis_cache *cache, const struct marker **out);
+
+#endif /* ANALYSIS_H */
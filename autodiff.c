@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "autodiff.h"
+#include "expr.h"
+
+#define LN10 2.302585092994045684
+
+struct emitter
+{
+    char *out;
+    size_t size;
+    size_t len;
+    int next_id;
+    bool ok;
+};
+
+/* a lowered subexpression, v<id> holds the value and d<id> the derivative */
+struct ad_val
+{
+    int id;
+    bool is_const; /* derivative is known to be zero, d<id> is not emitted */
+};
+
+static void emit(struct emitter *e, const char *fmt, ...)
+{
+    if (!e->ok)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(e->out + e->len, e->size - e->len, fmt, args);
+    va_end(args);
+
+    if (n < 0 || (size_t)n >= e->size - e->len)
+    {
+        e->ok = false;
+        return;
+    }
+    e->len += n;
+}
+
+/* writes the name of the derivative of v, or a literal zero */
+static const char *dref(struct ad_val v, char *buf)
+{
+    if (v.is_const)
+        return "0.0";
+    sprintf(buf, "d%d", v.id);
+    return buf;
+}
+
+static struct ad_val fail(struct emitter *e)
+{
+    e->ok = false;
+    return (struct ad_val){0, true};
+}
+
+static struct ad_val emit_unary_call(struct emitter *e, const char *name, struct ad_val a)
+{
+    struct ad_val r = {e->next_id++, a.is_const};
+    int n = r.id, i = a.id;
+    char da_buf[16];
+    const char *da = dref(a, da_buf);
+
+    if (a.is_const)
+    {
+        emit(e, "double v%d = %s(v%d);", n, name, i);
+        return r;
+    }
+
+    if (!strcmp(name, "sin"))
+        emit(e, "double v%d = sin(v%d), d%d = cos(v%d) * %s;", n, i, n, i, da);
+    else if (!strcmp(name, "cos"))
+        emit(e, "double v%d = cos(v%d), d%d = -sin(v%d) * %s;", n, i, n, i, da);
+    else if (!strcmp(name, "tan"))
+        emit(e, "double v%d = tan(v%d), d%d = (1.0 + v%d * v%d) * %s;", n, i, n, n, n, da);
+    else if (!strcmp(name, "sinh"))
+        emit(e, "double v%d = sinh(v%d), d%d = cosh(v%d) * %s;", n, i, n, i, da);
+    else if (!strcmp(name, "cosh"))
+        emit(e, "double v%d = cosh(v%d), d%d = sinh(v%d) * %s;", n, i, n, i, da);
+    else if (!strcmp(name, "tanh"))
+        emit(e, "double v%d = tanh(v%d), d%d = (1.0 - v%d * v%d) * %s;", n, i, n, n, n, da);
+    else if (!strcmp(name, "asin"))
+        emit(e, "double v%d = asin(v%d), d%d = %s / sqrt(1.0 - v%d * v%d);", n, i, n, da, i, i);
+    else if (!strcmp(name, "acos"))
+        emit(e, "double v%d = acos(v%d), d%d = -%s / sqrt(1.0 - v%d * v%d);", n, i, n, da, i, i);
+    else if (!strcmp(name, "atan"))
+        emit(e, "double v%d = atan(v%d), d%d = %s / (1.0 + v%d * v%d);", n, i, n, da, i, i);
+    else if (!strcmp(name, "exp"))
+        emit(e, "double v%d = exp(v%d), d%d = v%d * %s;", n, i, n, n, da);
+    else if (!strcmp(name, "log"))
+        emit(e, "double v%d = log(v%d), d%d = %s / v%d;", n, i, n, da, i);
+    else if (!strcmp(name, "log10"))
+        emit(e, "double v%d = log10(v%d), d%d = %s / (v%d * %.17g);", n, i, n, da, i, LN10);
+    else if (!strcmp(name, "sqrt"))
+        emit(e, "double v%d = sqrt(v%d), d%d = %s / (2.0 * v%d);", n, i, n, da, n);
+    else if (!strcmp(name, "ceil") || !strcmp(name, "floor"))
+    {
+        /* piecewise constant, the jumps are left to the caller */
+        emit(e, "double v%d = %s(v%d);", n, name, i);
+        r.is_const = true;
+    }
+    else
+        return fail(e);
+
+    return r;
+}
+
+static struct ad_val emit_binary_call(struct emitter *e, const char *name, struct ad_val a, struct ad_val b)
+{
+    struct ad_val r = {e->next_id++, a.is_const && b.is_const};
+    int n = r.id;
+    char da_buf[16], db_buf[16];
+    const char *da = dref(a, da_buf);
+    const char *db = dref(b, db_buf);
+
+    if (r.is_const)
+    {
+        emit(e, "double v%d = %s(v%d, v%d);", n, name, a.id, b.id);
+        return r;
+    }
+
+    if (!strcmp(name, "pow"))
+    {
+        if (b.is_const)
+            emit(e, "double v%d = pow(v%d, v%d), d%d = v%d * pow(v%d, v%d - 1.0) * %s;",
+                 n, a.id, b.id, n, b.id, a.id, b.id, da);
+        else
+            emit(e, "double v%d = pow(v%d, v%d), d%d = v%d * pow(v%d, v%d - 1.0) * %s + v%d * log(v%d) * %s;",
+                 n, a.id, b.id, n, b.id, a.id, b.id, da, n, a.id, db);
+    }
+    else if (!strcmp(name, "atan2"))
+        emit(e, "double v%d = atan2(v%d, v%d), d%d = (v%d * %s - v%d * %s) / (v%d * v%d + v%d * v%d);",
+             n, a.id, b.id, n, b.id, da, a.id, db, a.id, a.id, b.id, b.id);
+    else
+        return fail(e);
+
+    return r;
+}
+
+static struct ad_val emit_node(struct emitter *e, const struct expr *node)
+{
+    struct ad_val a, b, r;
+    char da_buf[16], db_buf[16];
+
+    /* left to the compiler as in graph_func, where 1/2 is 0 */
+    if (node->integer)
+    {
+        char text[1024];
+        if (!expr_format_integer(node, text, sizeof(text)))
+            return fail(e);
+        r = (struct ad_val){e->next_id++, true};
+        emit(e, "double v%d = %s;", r.id, text);
+        return r;
+    }
+
+    switch (node->kind)
+    {
+    case EXPR_X:
+        return (struct ad_val){0, false};
+
+    case EXPR_NUM:
+        r = (struct ad_val){e->next_id++, true};
+        emit(e, "double v%d = %.17g;", r.id, node->value);
+        return r;
+
+    case EXPR_NEG:
+        a = emit_node(e, node->args[0]);
+        r = (struct ad_val){e->next_id++, a.is_const};
+        if (a.is_const)
+            emit(e, "double v%d = -v%d;", r.id, a.id);
+        else
+            emit(e, "double v%d = -v%d, d%d = -d%d;", r.id, a.id, r.id, a.id);
+        return r;
+
+    case EXPR_ADD:
+    case EXPR_SUB:
+    {
+        char op = node->kind == EXPR_ADD ? '+' : '-';
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = (struct ad_val){e->next_id++, a.is_const && b.is_const};
+
+        if (r.is_const)
+            emit(e, "double v%d = v%d %c v%d;", r.id, a.id, op, b.id);
+        else
+            emit(e, "double v%d = v%d %c v%d, d%d = %s %c %s;",
+                 r.id, a.id, op, b.id, r.id, dref(a, da_buf), op, dref(b, db_buf));
+        return r;
+    }
+
+    case EXPR_MUL:
+    case EXPR_DIV:
+    {
+        char op = node->kind == EXPR_MUL ? '*' : '/';
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = (struct ad_val){e->next_id++, a.is_const && b.is_const};
+        int n = r.id;
+
+        if (r.is_const)
+            emit(e, "double v%d = v%d %c v%d;", n, a.id, op, b.id);
+        else if (op == '*' && a.is_const)
+            emit(e, "double v%d = v%d * v%d, d%d = v%d * d%d;", n, a.id, b.id, n, a.id, b.id);
+        else if (op == '*' && b.is_const)
+            emit(e, "double v%d = v%d * v%d, d%d = d%d * v%d;", n, a.id, b.id, n, a.id, b.id);
+        else if (op == '*')
+            emit(e, "double v%d = v%d * v%d, d%d = d%d * v%d + v%d * d%d;",
+                 n, a.id, b.id, n, a.id, b.id, a.id, b.id);
+        else if (b.is_const)
+            emit(e, "double v%d = v%d / v%d, d%d = d%d / v%d;", n, a.id, b.id, n, a.id, b.id);
+        else
+            emit(e, "double v%d = v%d / v%d, d%d = (%s - v%d * d%d) / v%d;",
+                 n, a.id, b.id, n, dref(a, da_buf), n, b.id, b.id);
+        return r;
+    }
+
+    case EXPR_CALL:
+        a = emit_node(e, node->args[0]);
+        if (node->argc == 1)
+            return emit_unary_call(e, node->text, a);
+        b = emit_node(e, node->args[1]);
+        return emit_binary_call(e, node->text, a, b);
+
+    case EXPR_T:
+        /* constant as far as x is concerned */
+        r = (struct ad_val){e->next_id++, true};
+        emit(e, "double v%d = t;", r.id);
+        return r;
+
+    case EXPR_Z:
+    case EXPR_I:
+        /* complex only */
+        break;
+    }
+
+    return fail(e);
+}
+
+bool ad_emit(const char *expr, char *out, size_t out_size)
+{
+    if (out_size == 0)
+        return false;
+    out[0] = '\0';
+
+    struct expr *tree = expr_parse(expr);
+    if (!tree)
+        return false;
+
+    struct emitter e = {out, out_size, 0, 1, true};
+    emit(&e, "double v0 = x, d0 = 1.0;");
+    struct ad_val r = emit_node(&e, tree);
+
+    char dr_buf[16];
+    emit(&e, "*dx = %s;return v%d;", dref(r, dr_buf), r.id);
+
+    expr_free(tree);
+    return e.ok;
+}
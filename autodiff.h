@@ -0,0 +1,18 @@
+#ifndef AUTODIFF_H
+#define AUTODIFF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * forward-mode differentiation of a graph expression.
+ *
+ * writes the C body of
+ *     double graph_func_d(const double x, const double t, double *dx)
+ * into out, where every subexpression is lowered to a (value, derivative)
+ * pair of temporaries. returns false for anything expr_parse rejects (or
+ * if out is too small) so the caller can fall back to a numeric derivative.
+ */
+bool ad_emit(const char *expr, char *out, size_t out_size);
+
+#endif /* AUTODIFF_H */
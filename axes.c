@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "axes.h"
+
+#define GLYPH_COLS 5
+#define GLYPH_ROWS 7
+#define GLYPH_SCALE 2
+#define GLYPH_W (GLYPH_COLS * GLYPH_SCALE)
+#define GLYPH_H (GLYPH_ROWS * GLYPH_SCALE)
+#define GLYPH_ADVANCE (GLYPH_W + GLYPH_SCALE)
+
+#define GLYPH_CHARS "0123456789-.e+"
+#define GLYPH_COUNT (sizeof(GLYPH_CHARS) - 1)
+
+#define ATLAS_W (GLYPH_COUNT * GLYPH_W)
+#define ATLAS_H GLYPH_H
+
+#define TICK_SPACING 100.0 /* preferred pixels between ticks */
+#define TICK_LENGTH 4
+#define LABEL_GAP 4
+#define MAX_TICK_INDEX 9007199254740992.0
+
+#define GRID_COLOR 0x262626ff
+#define TICK_COLOR 0x737373ff
+#define LABEL_COLOR 0xa0a0a0ff
+
+/* 5x7 bitmaps, one byte per row, most significant of the low 5 bits is the left column */
+static const unsigned char font[GLYPH_COUNT][GLYPH_ROWS] = {
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, /* 0 */
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* 1 */
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, /* 2 */
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, /* 3 */
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, /* 4 */
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, /* 5 */
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, /* 6 */
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, /* 7 */
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, /* 8 */
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, /* 9 */
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, /* - */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, /* . */
+    {0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e}, /* e */
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, /* + */
+};
+
+/* transparent where zero, blitted as is everywhere else */
+static unsigned int atlas[ATLAS_H][ATLAS_W];
+static signed char glyph_index[128];
+
+void axes_init(void)
+{
+    memset(glyph_index, -1, sizeof(glyph_index));
+
+    for (unsigned int g = 0; g < GLYPH_COUNT; ++g)
+    {
+        glyph_index[(int)GLYPH_CHARS[g]] = g;
+
+        for (int y = 0; y < GLYPH_H; ++y)
+        {
+            unsigned char row = font[g][y / GLYPH_SCALE];
+            for (int x = 0; x < GLYPH_W; ++x)
+            {
+                bool set = row & (0x10 >> (x / GLYPH_SCALE));
+                atlas[y][g * GLYPH_W + x] = set ? LABEL_COLOR : 0;
+            }
+        }
+    }
+}
+
+static void blit_glyph(unsigned int *pixels, int width, int height, int g, int x0, int y0)
+{
+    for (int y = 0; y < GLYPH_H; ++y)
+    {
+        int py = y0 + y;
+        if (py < 0 || py >= height)
+            continue;
+
+        const unsigned int *src = &atlas[y][g * GLYPH_W];
+        unsigned int *dst = &pixels[py * width];
+        for (int x = 0; x < GLYPH_W; ++x)
+        {
+            int px = x0 + x;
+            if (src[x] && px >= 0 && px < width)
+                dst[px] = src[x];
+        }
+    }
+}
+
+static void blit_label(unsigned int *pixels, int width, int height, const char *label, int x, int y)
+{
+    for (; *label; ++label, x += GLYPH_ADVANCE)
+    {
+        int g = glyph_index[*label & 0x7f];
+        if (g >= 0)
+            blit_glyph(pixels, width, height, g, x, y);
+    }
+}
+
+/* 1, 2 or 5 times a power of ten, close to TICK_SPACING pixels */
+static double nice_step(double scale)
+{
+    double raw = TICK_SPACING / scale;
+    double magnitude = pow(10, floor(log10(raw)));
+    double norm = raw / magnitude;
+
+    if (norm < 1.5)
+        return magnitude;
+    if (norm < 3.5)
+        return 2 * magnitude;
+    if (norm < 7.5)
+        return 5 * magnitude;
+    return 10 * magnitude;
+}
+
+static void format_labels(struct tick_set *ticks)
+{
+    double last = fmax(fabs(ticks->first * ticks->step),
+                       fabs((ticks->first + ticks->count - 1) * ticks->step));
+    int step_exp = floor(log10(ticks->step));
+    bool scientific = last >= 1e7 || step_exp < -5;
+
+    /* enough digits that neighbouring ticks never print the same */
+    int decimals = step_exp < 0 ? -step_exp : 0;
+    int digits = (last > 0 ? (int)floor(log10(last)) : 0) - step_exp;
+    if (digits < 0)
+        digits = 0;
+    if (digits > 16)
+        digits = 16;
+
+    for (int i = 0; i < ticks->count; ++i)
+    {
+        long long k = ticks->first + i;
+        double value = k * ticks->step;
+        char *label = ticks->labels[i];
+
+        if (k == 0)
+            strcpy(label, "0");
+        else if (scientific)
+            snprintf(label, LABEL_LEN, "%.*e", digits, value);
+        else
+            snprintf(label, LABEL_LEN, "%.*f", decimals, value);
+
+        ticks->label_widths[i] = strlen(label) * GLYPH_ADVANCE - GLYPH_SCALE;
+    }
+}
+
+/* ticks covering world [lo, hi], reformatting labels only if the set moved */
+static void update_ticks(struct tick_set *ticks, double lo, double hi, double step)
+{
+    double first = ceil(lo / step);
+    double last = floor(hi / step);
+    int count = 0;
+    /*
+     * beyond 2^53 tick indices stop being exact (deep zoom), draw none. the
+     * MAX_TICKS cap only bites on views wider than MAX_AXES_SIZE.
+     */
+    if (last >= first && fabs(first) < MAX_TICK_INDEX && fabs(last) < MAX_TICK_INDEX)
+        count = (last - first + 1 > MAX_TICKS) ? MAX_TICKS : (int)(last - first + 1);
+
+    if (ticks->step == step && ticks->first == (long long)first && ticks->count == count)
+        return;
+
+    ticks->step = step;
+    ticks->first = count ? (long long)first : 0;
+    ticks->count = count;
+    format_labels(ticks);
+}
+
+void axes_render(struct axes_cache *cache, unsigned int *pixels, int width, int height,
+                 double origin_x, double origin_y, double scale)
+{
+    struct tick_set *x_ticks = &cache->x, *y_ticks = &cache->y;
+
+    double step = nice_step(scale);
+    if (!isfinite(step) || step <= 0)
+        return;
+
+    update_ticks(x_ticks, -origin_x / scale, (width - origin_x) / scale, step);
+    update_ticks(y_ticks, (origin_y - height) / scale, origin_y / scale, step);
+
+    /* axis positions, pinned to the edges when the axis is off screen */
+    int axis_y = fmin(fmax(origin_y, 0), height - 1);
+    int axis_x = fmin(fmax(origin_x, 0), width - 1);
+
+    int label_y = axis_y + LABEL_GAP;
+    if (label_y > height - GLYPH_H - LABEL_GAP)
+        label_y = axis_y - LABEL_GAP - GLYPH_H;
+
+    int xs[MAX_TICKS], ys[MAX_TICKS];
+    for (int i = 0; i < x_ticks->count; ++i)
+        xs[i] = origin_x + (x_ticks->first + i) * step * scale;
+    for (int i = 0; i < y_ticks->count; ++i)
+        ys[i] = origin_y - (y_ticks->first + i) * step * scale;
+
+    /* grid first so neither direction draws over the other's labels */
+    for (int i = 0; i < x_ticks->count; ++i)
+    {
+        if (xs[i] < 0 || xs[i] >= width)
+            continue;
+        for (int y = 0; y < height; ++y)
+            pixels[y * width + xs[i]] = GRID_COLOR;
+        for (int y = axis_y - TICK_LENGTH; y <= axis_y + TICK_LENGTH; ++y)
+        {
+            if (y >= 0 && y < height)
+                pixels[y * width + xs[i]] = TICK_COLOR;
+        }
+    }
+    for (int i = 0; i < y_ticks->count; ++i)
+    {
+        if (ys[i] < 0 || ys[i] >= height)
+            continue;
+        unsigned int *row = &pixels[ys[i] * width];
+        for (int x = 0; x < width; ++x)
+            row[x] = GRID_COLOR;
+        for (int x = axis_x - TICK_LENGTH; x <= axis_x + TICK_LENGTH; ++x)
+        {
+            if (x >= 0 && x < width)
+                row[x] = TICK_COLOR;
+        }
+    }
+
+    for (int i = 0; i < x_ticks->count; ++i)
+    {
+        if (xs[i] < 0 || xs[i] >= width)
+            continue;
+        blit_label(pixels, width, height, x_ticks->labels[i],
+                   xs[i] - x_ticks->label_widths[i] / 2, label_y);
+    }
+    for (int i = 0; i < y_ticks->count; ++i)
+    {
+        /* the origin is already labelled on the x axis */
+        if (ys[i] < 0 || ys[i] >= height || y_ticks->first + i == 0)
+            continue;
+
+        int label_x = axis_x + LABEL_GAP;
+        if (label_x > width - y_ticks->label_widths[i] - LABEL_GAP)
+            label_x = axis_x - LABEL_GAP - y_ticks->label_widths[i];
+        blit_label(pixels, width, height, y_ticks->labels[i], label_x, ys[i] - GLYPH_H / 2);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef AXES_H
+#define AXES_H
+
+/*
+ * widest or tallest view that gets every tick. nice_step never puts ticks
+ * closer than 2 / 3.5 of TICK_SPACING (57 px), so 50 px bounds the count.
+ */
+#define MAX_AXES_SIZE 16384
+#define MAX_TICKS (MAX_AXES_SIZE / 50 + 2)
+#define LABEL_LEN 24
+
+struct tick_set
+{
+    double step;
+    long long first;
+    int count;
+    char labels[MAX_TICKS][LABEL_LEN];
+    int label_widths[MAX_TICKS];
+};
+
+/*
+ * formatted tick labels from the last axes_render, owned by the caller so
+ * views rendered on different threads don't share one. zero initialize.
+ */
+struct axes_cache
+{
+    struct tick_set x, y;
+};
+
+/* rasterizes the label font into the glyph atlas, call once at startup */
+void axes_init(void);
+
+/*
+ * draws grid lines, tick marks and tick labels for a view where world
+ * (0, 0) lands on screen (origin_x, origin_y) and one world unit spans
+ * scale pixels. labels are only reformatted when the tick set changes.
+ */
+void axes_render(struct axes_cache *cache, unsigned int *pixels, int width, int height,
+                 double origin_x, double origin_y, double scale);
+
+#endif /* AXES_H */
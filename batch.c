@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <SDL2/SDL.h>
+
+#include "batch.h"
+#include "jit.h"
+#include "pool.h"
+#include "plot.h"
+#include "eval.h"
+
+#define EXPR_LEN 256
+#define PATH_LEN 256
+#define LINE_LEN 1024
+#define MAX_SIZE MAX_AXES_SIZE
+
+/* finished images waiting for the writer, per pool thread */
+#define QUEUE_PER_THREAD 2
+
+struct batch_job
+{
+    char expr[EXPR_LEN];
+    char path[PATH_LEN];
+    struct plot_view view;
+    double time;
+    int program;
+};
+
+struct batch_program
+{
+    struct jit_module *module;
+    struct jit_funcs funcs;
+};
+
+/* scratch owned by one pool thread */
+struct batch_thread
+{
+    unsigned int *pixels;
+    size_t capacity;
+    struct axes_cache axes;
+};
+
+struct image
+{
+    SDL_Surface *surface;
+    const char *path;
+};
+
+static struct batch_job *jobs;
+static struct batch_program *programs;
+static struct batch_thread *threads;
+
+static SDL_atomic_t rendered;
+static SDL_atomic_t failed;
+
+/* ring of images for the writer thread, a NULL surface tells it to stop */
+static struct image *queue;
+static int queue_size;
+static int queue_head, queue_count;
+static SDL_mutex *queue_lock;
+static SDL_cond *queue_filled;
+static SDL_cond *queue_drained;
+
+static void queue_push(SDL_Surface *surface, const char *path)
+{
+    SDL_LockMutex(queue_lock);
+    while (queue_count == queue_size)
+        SDL_CondWait(queue_drained, queue_lock);
+    queue[(queue_head + queue_count) % queue_size] = (struct image){surface, path};
+    ++queue_count;
+    SDL_CondSignal(queue_filled);
+    SDL_UnlockMutex(queue_lock);
+}
+
+static int writer_main(void *data)
+{
+    (void)data;
+
+    for (;;)
+    {
+        SDL_LockMutex(queue_lock);
+        while (queue_count == 0)
+            SDL_CondWait(queue_filled, queue_lock);
+        struct image image = queue[queue_head];
+        queue_head = (queue_head + 1) % queue_size;
+        --queue_count;
+        SDL_CondSignal(queue_drained);
+        SDL_UnlockMutex(queue_lock);
+
+        if (!image.surface)
+            break;
+
+        if (SDL_SaveBMP(image.surface, image.path) < 0)
+        {
+            printf("Can't write %s: %s\n", image.path, SDL_GetError());
+            SDL_AtomicAdd(&failed, 1);
+        }
+        else
+            SDL_AtomicAdd(&rendered, 1);
+        SDL_FreeSurface(image.surface);
+    }
+    return 0;
+}
+
+static void render_job(void *ctx, int index)
+{
+    (void)ctx;
+    struct batch_job *job = &jobs[index];
+    struct batch_program *program = &programs[job->program];
+    if (!program->module)
+    {
+        SDL_AtomicAdd(&failed, 1);
+        return;
+    }
+
+    struct batch_thread *thread = &threads[pool_worker()];
+    int width = job->view.width, height = job->view.height;
+    size_t size = (size_t)width * height;
+    if (size > thread->capacity)
+    {
+        free(thread->pixels);
+        thread->pixels = malloc(size * sizeof(*thread->pixels));
+        thread->capacity = thread->pixels ? size : 0;
+    }
+
+    /* the framebuffer is reused right away, the writer gets a copy */
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (!thread->pixels || !surface)
+    {
+        printf("Out of memory rendering %s\n", job->path);
+        SDL_FreeSurface(surface);
+        SDL_AtomicAdd(&failed, 1);
+        return;
+    }
+
+    struct jit_funcs funcs = program->funcs;
+    funcs.time = job->time;
+    plot_render(&funcs, &job->view, &thread->axes, NULL, thread->pixels);
+
+    for (int y = 0; y < height; ++y)
+        memcpy((char *)surface->pixels + (size_t)y * surface->pitch,
+               thread->pixels + (size_t)y * width, width * sizeof(*thread->pixels));
+
+    queue_push(surface, job->path);
+}
+
+/* dd_parse with an optional sign */
+static bool parse_coord(const char *s, dd *out)
+{
+    bool negative = *s == '-';
+    if (*s == '-' || *s == '+')
+        ++s;
+    if (!dd_parse(s, out))
+        return false;
+    if (negative)
+        *out = (dd){-out->hi, -out->lo};
+    return true;
+}
+
+static int read_manifest(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+    {
+        printf("Can't open %s for reading\n", path);
+        return -1;
+    }
+
+    char line[LINE_LEN];
+    int count = 0, capacity = 0;
+    for (int number = 1; fgets(line, sizeof(line), fp); ++number)
+    {
+        char expr[EXPR_LEN], cx[64], cy[64], out[PATH_LEN];
+        struct plot_view view;
+        double time = 0;
+
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+            continue;
+
+        int fields = sscanf(p, "%255s %63s %63s %lf %d %d %255s %lf", expr, cx, cy,
+                            &view.scale, &view.width, &view.height, out, &time);
+        if (fields < 7 || !isfinite(time) ||
+            !parse_coord(cx, &view.center_x) || !parse_coord(cy, &view.center_y) ||
+            !(isfinite(view.scale) && view.scale > 0) ||
+            view.width < 1 || view.width > MAX_SIZE || view.height < 1 || view.height > MAX_SIZE)
+        {
+            printf("%s:%d: bad job, skipped\n", path, number);
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            int grown_capacity = capacity ? capacity * 2 : 256;
+            struct batch_job *grown = realloc(jobs, grown_capacity * sizeof(*jobs));
+            if (!grown)
+            {
+                printf("Out of memory reading %s\n", path);
+                fclose(fp);
+                free(jobs);
+                jobs = NULL;
+                return -1;
+            }
+            jobs = grown;
+            capacity = grown_capacity;
+        }
+        struct batch_job *job = &jobs[count++];
+        strcpy(job->expr, expr);
+        strcpy(job->path, out);
+        job->view = view;
+        job->time = time;
+    }
+    fclose(fp);
+    return count;
+}
+
+static int compare_jobs(const void *a, const void *b)
+{
+    const struct batch_job *x = *(const struct batch_job *const *)a;
+    const struct batch_job *y = *(const struct batch_job *const *)b;
+    return strcmp(x->expr, y->expr);
+}
+
+/* compiles each distinct expression once, returns how many there were or -1 */
+static int compile_programs(int count)
+{
+    /* sorted by expression so duplicates end up next to each other */
+    struct batch_job **order = malloc(count * sizeof(*order));
+    programs = malloc(count * sizeof(*programs));
+    if (!order || !programs)
+    {
+        printf("Out of memory for %d jobs\n", count);
+        free(order);
+        free(programs);
+        programs = NULL;
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i)
+        order[i] = &jobs[i];
+    qsort(order, count, sizeof(*order), compare_jobs);
+
+    int distinct = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (i > 0 && !strcmp(order[i]->expr, order[i - 1]->expr))
+        {
+            order[i]->program = distinct - 1;
+            continue;
+        }
+
+        struct batch_program *program = &programs[distinct];
+        program->module = jit_build(order[i]->expr, &program->funcs);
+        if (!program->module)
+            printf("Can't compile %s, its jobs are skipped\n", order[i]->expr);
+        else
+        {
+            /* single precision only where it pays, timed over the first view */
+            const struct plot_view *view = &order[i]->view;
+            double cx = dd_to_double(view->center_x), half_w = view->width / 2.0 / view->scale;
+            program->funcs.time = order[i]->time;
+            if (!eval_float_faster(&program->funcs, cx - half_w, cx + half_w))
+                program->funcs.graph_func_batch_f = NULL;
+        }
+        order[i]->program = distinct++;
+    }
+    free(order);
+    return distinct;
+}
+
+/* in megabytes, 0 where unknown */
+static double peak_rss(void)
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+int batch_run(const char *manifest_path)
+{
+    double freq = SDL_GetPerformanceFrequency();
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    int count = read_manifest(manifest_path);
+    if (count < 0)
+        return EXIT_FAILURE;
+    if (count == 0)
+    {
+        printf("batch: no jobs in %s\n", manifest_path);
+        free(jobs);
+        return EXIT_SUCCESS;
+    }
+
+    int distinct = compile_programs(count);
+    if (distinct < 0)
+    {
+        free(jobs);
+        jobs = NULL;
+        return EXIT_FAILURE;
+    }
+    Uint64 compiled = SDL_GetPerformanceCounter();
+
+    threads = calloc(pool_size(), sizeof(*threads));
+    queue_size = pool_size() * QUEUE_PER_THREAD;
+    queue = malloc(queue_size * sizeof(*queue));
+    queue_head = queue_count = 0;
+    queue_lock = SDL_CreateMutex();
+    queue_filled = SDL_CreateCond();
+    queue_drained = SDL_CreateCond();
+    SDL_AtomicSet(&rendered, 0);
+    SDL_AtomicSet(&failed, 0);
+
+    int status = EXIT_SUCCESS;
+    SDL_Thread *writer = NULL;
+    if (!threads || !queue)
+        printf("Out of memory for %d render threads\n", pool_size());
+    else if (!queue_lock || !queue_filled || !queue_drained)
+        printf("error in SDL_CreateMutex or SDL_CreateCond: %s\n", SDL_GetError());
+    else if (!(writer = SDL_CreateThread(writer_main, "writer", NULL)))
+        printf("error in SDL_CreateThread: %s\n", SDL_GetError());
+
+    if (writer == NULL)
+        status = EXIT_FAILURE;
+    else
+    {
+        pool_for(count, render_job, NULL);
+        queue_push(NULL, NULL);
+        SDL_WaitThread(writer, NULL);
+    }
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    double compile_s = (compiled - start) / freq;
+    double total_s = (end - start) / freq;
+    printf("batch: %d jobs, %d expressions compiled in %.3f s\n", count, distinct, compile_s);
+    printf("batch: %d written, %d failed in %.3f s, %.1f jobs/s on %d threads, peak RSS %.1f MB\n",
+           SDL_AtomicGet(&rendered), SDL_AtomicGet(&failed), total_s,
+           SDL_AtomicGet(&rendered) / total_s, pool_size(), peak_rss());
+
+    SDL_DestroyCond(queue_drained);
+    SDL_DestroyCond(queue_filled);
+    SDL_DestroyMutex(queue_lock);
+    free(queue);
+    for (int i = 0; threads && i < pool_size(); ++i)
+        free(threads[i].pixels);
+    free(threads);
+    for (int i = 0; i < distinct; ++i)
+        jit_release(programs[i].module);
+    free(programs);
+    free(jobs);
+    jobs = NULL;
+
+    if (SDL_AtomicGet(&failed) > 0)
+        status = EXIT_FAILURE;
+    return status;
+}
@@ -0,0 +1,17 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/*
+ * headless batch rendering. the manifest has one job per line:
+ *
+ *     expression center_x center_y scale width height output.bmp [t]
+ *
+ * t is 0 when left out. blank lines and lines starting with # are
+ * skipped. every distinct expression is compiled once and shared by its
+ * jobs, jobs render in parallel on the thread pool and images are written
+ * by a separate thread while rendering goes on. needs pool_init and
+ * axes_init first.
+ */
+int batch_run(const char *manifest_path);
+
+#endif /* BATCH_H */
@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include "cheb.h"
+#include "watchdog.h"
+
+/* pixels a fit may be off by when it is made */
+#define FIT_PX 0.25
+/* pixels it may be off by before zooming in forces a refit */
+#define ERROR_PX 0.5
+/* fitted range on each side of the visible one, in visible widths */
+#define MARGIN 1.0
+/* segments the fitted range starts out with */
+#define SEGMENTS 16
+/* halvings of a segment before it is left to the exact function */
+#define MAX_DEPTH 10
+/* points between the nodes a fit is checked at */
+#define CHECKS (2 * (CHEB_DEGREE + 1))
+/* evaluations fit_segment takes */
+#define FIT_COST (CHEB_DEGREE + 1 + CHECKS)
+
+#define PI 3.14159265358979323846
+
+void cheb_reset(struct cheb_cache *cache)
+{
+    cache->count = 0;
+    cache->fitted = false;
+}
+
+static double clenshaw(const struct cheb_segment *seg, double x)
+{
+    double t = (2 * x - seg->a - seg->b) / (seg->b - seg->a);
+    double b1 = 0, b2 = 0;
+    for (int k = seg->degree; k > 0; --k)
+    {
+        double b0 = 2 * t * b1 - b2 + seg->c[k];
+        b2 = b1;
+        b1 = b0;
+    }
+    return t * b1 - b2 + seg->c[0];
+}
+
+/* interpolates f at the chebyshev nodes of seg, false if that misses by more than tol */
+static bool fit_segment(const struct jit_funcs *funcs, struct cheb_segment *seg, double tol)
+{
+    const int n = CHEB_DEGREE + 1;
+    double mid = (seg->a + seg->b) / 2, half = (seg->b - seg->a) / 2;
+    double xs[CHECKS], ys[CHECKS];
+
+    for (int k = 0; k < n; ++k)
+        xs[k] = mid + half * cos(PI * (k + 0.5) / n);
+    funcs->graph_func_batch(xs, ys, n, funcs->time);
+
+    for (int j = 0; j < n; ++j)
+    {
+        double sum = 0;
+        for (int k = 0; k < n; ++k)
+            sum += ys[k] * cos(PI * j * (k + 0.5) / n);
+        seg->c[j] = sum * 2 / n;
+    }
+    seg->c[0] /= 2;
+    seg->exact = false;
+
+    /* nan coefficients fail every comparison below */
+    if (!(fabs(seg->c[CHEB_DEGREE - 1]) + fabs(seg->c[CHEB_DEGREE]) <= tol / 4))
+        return false;
+
+    /* |T_k| <= 1, so dropping terms costs at most their sum */
+    double dropped = 0;
+    seg->degree = CHEB_DEGREE;
+    while (seg->degree > 0 && dropped + fabs(seg->c[seg->degree]) <= tol / 4)
+        dropped += fabs(seg->c[seg->degree--]);
+
+    /* checked with the terms that are kept */
+    for (int i = 0; i < CHECKS; ++i)
+        xs[i] = mid + half * (-1 + (2 * i + 1.0) / CHECKS);
+    funcs->graph_func_batch(xs, ys, CHECKS, funcs->time);
+    for (int i = 0; i < CHECKS; ++i)
+    {
+        if (!(fabs(clenshaw(seg, xs[i]) - ys[i]) <= tol))
+            return false;
+    }
+    return true;
+}
+
+static bool push_segment(struct cheb_cache *cache, const struct cheb_segment *seg)
+{
+    if (cache->count == cache->capacity)
+    {
+        int capacity = cache->capacity ? cache->capacity * 2 : 64;
+        struct cheb_segment *grown = realloc(cache->segments, capacity * sizeof(*grown));
+        if (!grown)
+            return false;
+        cache->segments = grown;
+        cache->capacity = capacity;
+    }
+    cache->segments[cache->count++] = *seg;
+    return true;
+}
+
+/*
+ * fits [a, b] as one segment or halves it until the pieces fit, left to
+ * right. every try is paid from budget, what is left when it runs out is
+ * evaluated exactly.
+ */
+static bool fit(struct cheb_cache *cache, const struct jit_funcs *funcs, double a, double b,
+                double tol, int depth, long *budget)
+{
+    if (watchdog_cancelled())
+        return false;
+
+    struct cheb_segment seg = {.a = a, .b = b};
+    if (*budget < FIT_COST)
+    {
+        seg.exact = true;
+        return push_segment(cache, &seg);
+    }
+
+    *budget -= FIT_COST;
+    double m = a + (b - a) / 2;
+    if (fit_segment(funcs, &seg, tol))
+        return push_segment(cache, &seg);
+
+    /* poles, jumps and anything too wiggly end up here */
+    if (depth == MAX_DEPTH || m == a || m == b)
+    {
+        seg.exact = true;
+        return push_segment(cache, &seg);
+    }
+    return fit(cache, funcs, a, m, tol, depth + 1, budget) &&
+           fit(cache, funcs, m, b, tol, depth + 1, budget);
+}
+
+void cheb_update(struct cheb_cache *cache, const struct jit_funcs *funcs,
+                 double x_min, double x_max, double scale, long budget)
+{
+    if (cache->fitted && x_min >= cache->lo && x_max <= cache->hi &&
+        scale <= cache->scale * (ERROR_PX / FIT_PX))
+        return;
+
+    double margin = (x_max - x_min) * MARGIN;
+    double lo = x_min - margin, hi = x_max + margin;
+    if (!isfinite(lo) || !isfinite(hi) || !(lo < hi))
+    {
+        cheb_reset(cache);
+        return;
+    }
+
+    cache->count = 0;
+    cache->lo = lo;
+    cache->hi = hi;
+    cache->scale = scale;
+
+    /* neighbouring segments share the expression for their common end, so there are no gaps */
+    double width = (hi - lo) / SEGMENTS;
+    cache->fitted = true;
+    for (int i = 0; i < SEGMENTS && cache->fitted; ++i)
+    {
+        double a = lo + i * width, b = i == SEGMENTS - 1 ? hi : lo + (i + 1) * width;
+        cache->fitted = fit(cache, funcs, a, b, FIT_PX / scale, 0, &budget);
+    }
+    if (!cache->fitted)
+        cheb_reset(cache);
+}
+
+/* index of the segment holding x, searched from hint since samples come in order */
+static int locate(const struct cheb_cache *cache, double x, int hint)
+{
+    const struct cheb_segment *segs = cache->segments;
+    if (x >= segs[hint].a && (x < segs[hint].b || hint == cache->count - 1))
+        return hint;
+    if (hint + 1 < cache->count && x >= segs[hint + 1].a && x < segs[hint + 1].b)
+        return hint + 1;
+
+    int lo = 0, hi = cache->count - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (segs[mid].a <= x)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+void cheb_eval(const struct cheb_cache *cache, const struct jit_funcs *funcs,
+               enum eval_precision precision, const double *xs, double *ys, int n)
+{
+    if (!cache->fitted)
+    {
+        eval_batch(funcs, precision, xs, ys, n);
+        return;
+    }
+
+    /* samples outside the fit or on exact segments are gathered and evaluated together */
+    double miss_x[EVAL_BATCH], miss_y[EVAL_BATCH];
+    int miss_index[EVAL_BATCH];
+    int misses = 0;
+    int seg = 0;
+
+    for (int i = 0; i < n; ++i)
+    {
+        double x = xs[i];
+        if (x >= cache->lo && x <= cache->hi)
+        {
+            seg = locate(cache, x, seg);
+            if (!cache->segments[seg].exact)
+            {
+                ys[i] = clenshaw(&cache->segments[seg], x);
+                continue;
+            }
+        }
+
+        miss_x[misses] = x;
+        miss_index[misses++] = i;
+        if (misses == EVAL_BATCH)
+        {
+            eval_batch(funcs, precision, miss_x, miss_y, misses);
+            for (int j = 0; j < misses; ++j)
+                ys[miss_index[j]] = miss_y[j];
+            misses = 0;
+        }
+    }
+
+    if (misses)
+    {
+        eval_batch(funcs, precision, miss_x, miss_y, misses);
+        for (int j = 0; j < misses; ++j)
+            ys[miss_index[j]] = miss_y[j];
+    }
+}
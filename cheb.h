@@ -0,0 +1,54 @@
+#ifndef CHEB_H
+#define CHEB_H
+
+#include <stdbool.h>
+
+#include "jit.h"
+#include "eval.h"
+
+#define CHEB_DEGREE 24
+
+/* f on [a, b] as a chebyshev series, or evaluated exactly where none fits */
+struct cheb_segment
+{
+    double a, b;
+    double c[CHEB_DEGREE + 1];
+    int degree; /* terms past the ones that matter are dropped */
+    bool exact;
+};
+
+/*
+ * piecewise chebyshev fit of one function around the visible range,
+ * owned by the caller like axes_cache. zero initialize.
+ */
+struct cheb_cache
+{
+    struct cheb_segment *segments; /* sorted, covering [lo, hi] without gaps */
+    int count, capacity;
+    double lo, hi;
+    double scale; /* pixels per unit the fit was made for */
+    bool fitted;
+};
+
+/* forget the fit, call after the function changes */
+void cheb_reset(struct cheb_cache *cache);
+
+/*
+ * makes sure the fit covers [x_min, x_max] to well under a pixel at
+ * scale. refits over the range plus a margin on both sides only when the
+ * range leaves the fitted one or scale grows enough that the old error
+ * would show, so panning and zooming mostly reuse the previous fit. a
+ * refit evaluates funcs at most about budget times, segments it can't
+ * afford are left exact.
+ */
+void cheb_update(struct cheb_cache *cache, const struct jit_funcs *funcs,
+                 double x_min, double x_max, double scale, long budget);
+
+/*
+ * like eval_batch, through the fit where there is one. cache is only
+ * read, so any number of threads may evaluate at once between updates.
+ */
+void cheb_eval(const struct cheb_cache *cache, const struct jit_funcs *funcs,
+               enum eval_precision precision, const double *xs, double *ys, int n);
+
+#endif /* CHEB_H */
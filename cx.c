@@ -0,0 +1,102 @@
+#include <math.h>
+#include <complex.h>
+
+#include "cx.h"
+
+#define LN10 2.302585092994045684
+
+static double complex load(const cx *a)
+{
+    return a->re + a->im * I;
+}
+
+static void store(cx *r, double complex a)
+{
+    r->re = creal(a);
+    r->im = cimag(a);
+}
+
+void cx_div(cx *r, const cx *a, const cx *b)
+{
+    /* smith's method, a / b without overflowing |b|^2 */
+    if (fabs(b->re) >= fabs(b->im))
+    {
+        double t = b->im / b->re, d = b->re + b->im * t;
+        *r = (cx){(a->re + a->im * t) / d, (a->im - a->re * t) / d};
+    }
+    else
+    {
+        double t = b->re / b->im, d = b->re * t + b->im;
+        *r = (cx){(a->re * t + a->im) / d, (a->im * t - a->re) / d};
+    }
+}
+
+void cx_sqrt(cx *r, const cx *a)
+{
+    store(r, csqrt(load(a)));
+}
+
+void cx_exp(cx *r, const cx *a)
+{
+    store(r, cexp(load(a)));
+}
+
+void cx_log(cx *r, const cx *a)
+{
+    store(r, clog(load(a)));
+}
+
+void cx_log10(cx *r, const cx *a)
+{
+    store(r, clog(load(a)) / LN10);
+}
+
+void cx_pow(cx *r, const cx *a, const cx *b)
+{
+    store(r, cpow(load(a), load(b)));
+}
+
+void cx_sin(cx *r, const cx *a)
+{
+    store(r, csin(load(a)));
+}
+
+void cx_cos(cx *r, const cx *a)
+{
+    store(r, ccos(load(a)));
+}
+
+void cx_tan(cx *r, const cx *a)
+{
+    store(r, ctan(load(a)));
+}
+
+void cx_sinh(cx *r, const cx *a)
+{
+    store(r, csinh(load(a)));
+}
+
+void cx_cosh(cx *r, const cx *a)
+{
+    store(r, ccosh(load(a)));
+}
+
+void cx_tanh(cx *r, const cx *a)
+{
+    store(r, ctanh(load(a)));
+}
+
+void cx_asin(cx *r, const cx *a)
+{
+    store(r, casin(load(a)));
+}
+
+void cx_acos(cx *r, const cx *a)
+{
+    store(r, cacos(load(a)));
+}
+
+void cx_atan(cx *r, const cx *a)
+{
+    store(r, catan(load(a)));
+}
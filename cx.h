@@ -0,0 +1,31 @@
+#ifndef CX_H
+#define CX_H
+
+/*
+ * complex numbers for domain coloring. tcc has no _Complex, so jit
+ * compiled code passes this struct by pointer to the host functions below,
+ * the same plain C ABI dd.h uses. + - * are inlined by the code generator.
+ */
+typedef struct
+{
+    double re, im;
+} cx;
+
+void cx_div(cx *r, const cx *a, const cx *b);
+
+void cx_sqrt(cx *r, const cx *a);
+void cx_exp(cx *r, const cx *a);
+void cx_log(cx *r, const cx *a);
+void cx_log10(cx *r, const cx *a);
+void cx_pow(cx *r, const cx *a, const cx *b);
+void cx_sin(cx *r, const cx *a);
+void cx_cos(cx *r, const cx *a);
+void cx_tan(cx *r, const cx *a);
+void cx_sinh(cx *r, const cx *a);
+void cx_cosh(cx *r, const cx *a);
+void cx_tanh(cx *r, const cx *a);
+void cx_asin(cx *r, const cx *a);
+void cx_acos(cx *r, const cx *a);
+void cx_atan(cx *r, const cx *a);
+
+#endif /* CX_H */
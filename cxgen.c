@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "cxgen.h"
+#include "expr.h"
+
+struct emitter
+{
+    char *out;
+    size_t size;
+    size_t len;
+    int next_id;
+    bool ok;
+};
+
+static const char *unary_functions[] = {
+    "sqrt", "exp", "log", "log10", "sin", "cos", "tan",
+    "sinh", "cosh", "tanh", "asin", "acos", "atan",
+};
+
+static void emit(struct emitter *e, const char *fmt, ...)
+{
+    if (!e->ok)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(e->out + e->len, e->size - e->len, fmt, args);
+    va_end(args);
+
+    if (n < 0 || (size_t)n >= e->size - e->len)
+    {
+        e->ok = false;
+        return;
+    }
+    e->len += n;
+}
+
+static bool has_unary(const char *name)
+{
+    for (size_t i = 0; i < sizeof(unary_functions) / sizeof(unary_functions[0]); ++i)
+    {
+        if (!strcmp(unary_functions[i], name))
+            return true;
+    }
+    return false;
+}
+
+/* returns the id of the temporary v<id> holding the value of node */
+static int emit_node(struct emitter *e, const struct expr *node)
+{
+    int a, b, r;
+
+    switch (node->kind)
+    {
+    case EXPR_Z:
+        return 0;
+
+    case EXPR_I:
+        r = e->next_id++;
+        emit(e, "cx v%d = {0.0, 1.0};", r);
+        return r;
+
+    case EXPR_T:
+        r = e->next_id++;
+        emit(e, "cx v%d = {t, 0.0};", r);
+        return r;
+
+    case EXPR_NUM:
+        r = e->next_id++;
+        emit(e, "cx v%d = {%.17g, 0.0};", r, node->value);
+        return r;
+
+    case EXPR_NEG:
+        a = emit_node(e, node->args[0]);
+        r = e->next_id++;
+        emit(e, "cx v%d = {-v%d.re, -v%d.im};", r, a, a);
+        return r;
+
+    case EXPR_ADD:
+    case EXPR_SUB:
+    {
+        char op = node->kind == EXPR_ADD ? '+' : '-';
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = e->next_id++;
+        emit(e, "cx v%d = {v%d.re %c v%d.re, v%d.im %c v%d.im};", r, a, op, b, a, op, b);
+        return r;
+    }
+
+    case EXPR_MUL:
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = e->next_id++;
+        emit(e, "cx v%d = {v%d.re * v%d.re - v%d.im * v%d.im, v%d.re * v%d.im + v%d.im * v%d.re};",
+             r, a, b, a, b, a, b, a, b);
+        return r;
+
+    case EXPR_DIV:
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = e->next_id++;
+        emit(e, "cx v%d;cx_div(&v%d, &v%d, &v%d);", r, r, a, b);
+        return r;
+
+    case EXPR_CALL:
+        a = emit_node(e, node->args[0]);
+        if (node->argc == 1 && has_unary(node->text))
+        {
+            r = e->next_id++;
+            emit(e, "cx v%d;cx_%s(&v%d, &v%d);", r, node->text, r, a);
+            return r;
+        }
+        if (node->argc == 2 && !strcmp(node->text, "pow"))
+        {
+            b = emit_node(e, node->args[1]);
+            r = e->next_id++;
+            emit(e, "cx v%d;cx_pow(&v%d, &v%d, &v%d);", r, r, a, b);
+            return r;
+        }
+        break;
+
+    case EXPR_X:
+        /* real only */
+        break;
+    }
+
+    e->ok = false;
+    return 0;
+}
+
+bool cx_emit(const char *expr, char *out, size_t out_size)
+{
+    if (out_size == 0)
+        return false;
+    out[0] = '\0';
+
+    struct expr *tree = expr_parse(expr);
+    if (!tree)
+        return false;
+
+    struct emitter e = {out, out_size, 0, 1, true};
+    emit(&e, "cx v0 = *z;");
+    int r = emit_node(&e, tree);
+    emit(&e, "*w = v%d;", r);
+
+    expr_free(tree);
+    return e.ok;
+}
@@ -0,0 +1,18 @@
+#ifndef CXGEN_H
+#define CXGEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * complex lowering of an f(z) expression.
+ *
+ * writes C statements into out that read the input from const cx *z and
+ * store f(z) to cx *w, with + - * inlined and everything else turned into
+ * calls to the cx_* functions from cx.h. returns false for anything
+ * expr_parse rejects, for x and for functions without a complex
+ * counterpart (atan2, ceil, floor), or if out is too small.
+ */
+bool cx_emit(const char *expr, char *out, size_t out_size);
+
+#endif /* CXGEN_H */
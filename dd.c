@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+
+#include "dd.h"
+
+/* 2^-104, where a series term stops mattering */
+#define DD_EPS 4.93038065763132e-32
+
+static const dd dd_2pi = {6.283185307179586, 2.4492935982947064e-16};
+static const dd dd_pi = {3.141592653589793, 1.2246467991473532e-16};
+static const dd dd_pi2 = {1.5707963267948966, 6.123233995736766e-17};
+static const dd dd_ln2 = {0.6931471805599453, 2.3190468138462996e-17};
+static const dd dd_ln10 = {2.302585092994046, -2.1707562233822494e-16};
+
+/* exact product of two doubles via dekker's split */
+static dd two_prod(double a, double b)
+{
+    double p = a * b;
+    double t = 134217729.0 * a;
+    double a_hi = t - (t - a), a_lo = a - a_hi;
+    t = 134217729.0 * b;
+    double b_hi = t - (t - b), b_lo = b - b_hi;
+    return (dd){p, ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo};
+}
+
+static dd add(dd a, dd b)
+{
+    dd s = dd_two_sum(a.hi, b.hi);
+    dd t = dd_two_sum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = dd_quick_two_sum(s.hi, s.lo);
+    s.lo += t.lo;
+    return dd_quick_two_sum(s.hi, s.lo);
+}
+
+static dd neg(dd a)
+{
+    return (dd){-a.hi, -a.lo};
+}
+
+static dd sub(dd a, dd b)
+{
+    return add(a, neg(b));
+}
+
+static dd mul(dd a, dd b)
+{
+    dd p = two_prod(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return dd_quick_two_sum(p.hi, p.lo);
+}
+
+static dd mul_d(dd a, double b)
+{
+    dd p = two_prod(a.hi, b);
+    p.lo += a.lo * b;
+    return dd_quick_two_sum(p.hi, p.lo);
+}
+
+static dd div_(dd a, dd b)
+{
+    double q1 = a.hi / b.hi;
+    dd r = sub(a, mul_d(b, q1));
+    double q2 = r.hi / b.hi;
+    r = sub(r, mul_d(b, q2));
+    double q3 = r.hi / b.hi;
+    return dd_sum_d(dd_quick_two_sum(q1, q2), q3);
+}
+
+static dd div_d(dd a, double b)
+{
+    return div_(a, (dd){b, 0});
+}
+
+static dd from(double a)
+{
+    return (dd){a, 0};
+}
+
+static dd ldexp_(dd a, int e)
+{
+    return (dd){ldexp(a.hi, e), ldexp(a.lo, e)};
+}
+
+static dd exp_(dd a)
+{
+    if (a.hi > 709.78)
+        return from(INFINITY);
+    if (a.hi < -745.2)
+        return from(0);
+    if (a.hi == 0)
+        return from(1);
+
+    /* exp(a) = 2^k * exp(r / 512)^512 with |r| <= ln2 / 2 */
+    double k = floor(a.hi / dd_ln2.hi + 0.5);
+    dd r = ldexp_(sub(a, mul_d(dd_ln2, k)), -9);
+
+    dd s = r, t = r;
+    for (int i = 2; i < 30; ++i)
+    {
+        t = div_d(mul(t, r), i);
+        s = add(s, t);
+        if (fabs(t.hi) <= DD_EPS)
+            break;
+    }
+
+    /* s holds exp(r) - 1, squaring as (1 + s)^2 - 1 keeps the small part exact */
+    for (int i = 0; i < 9; ++i)
+        s = add(mul_d(s, 2), mul(s, s));
+
+    return ldexp_(dd_sum_d(s, 1), (int)k);
+}
+
+static dd log_(dd a)
+{
+    if (a.hi <= 0)
+        return from(a.hi == 0 ? -INFINITY : NAN);
+    if (isinf(a.hi))
+        return a;
+
+    /* one newton step on exp(x) = a doubles the precision of log(a.hi) */
+    dd x = from(log(a.hi));
+    return dd_sum_d(add(x, mul(a, exp_(neg(x)))), -1);
+}
+
+static dd sqrt_(dd a)
+{
+    if (a.hi <= 0)
+        return from(a.hi == 0 ? 0 : NAN);
+
+    double x = 1 / sqrt(a.hi);
+    double ax = a.hi * x;
+    dd diff = sub(a, two_prod(ax, ax));
+    return dd_two_sum(ax, diff.hi * x * 0.5);
+}
+
+static dd sin_taylor(dd r)
+{
+    dd s = r, t = r;
+    dd r2 = neg(mul(r, r));
+    for (int i = 3; i < 60; i += 2)
+    {
+        t = div_d(mul(t, r2), (double)(i - 1) * i);
+        s = add(s, t);
+        if (fabs(t.hi) <= DD_EPS)
+            break;
+    }
+    return s;
+}
+
+static dd cos_taylor(dd r)
+{
+    dd s = from(1), t = from(1);
+    dd r2 = neg(mul(r, r));
+    for (int i = 2; i < 60; i += 2)
+    {
+        t = div_d(mul(t, r2), (double)(i - 1) * i);
+        s = add(s, t);
+        if (fabs(t.hi) <= DD_EPS)
+            break;
+    }
+    return s;
+}
+
+/* reduces a to r in [-pi/4, pi/4] and returns the quadrant */
+static int reduce(dd a, dd *r)
+{
+    double z = nearbyint(a.hi / dd_2pi.hi);
+    dd t = sub(a, mul_d(dd_2pi, z));
+    double j = nearbyint(t.hi / dd_pi2.hi);
+    *r = sub(t, mul_d(dd_pi2, j));
+    return ((int)j % 4 + 4) % 4;
+}
+
+static dd sin_(dd a)
+{
+    if (!isfinite(a.hi))
+        return from(NAN);
+
+    dd r;
+    switch (reduce(a, &r))
+    {
+    case 0:
+        return sin_taylor(r);
+    case 1:
+        return cos_taylor(r);
+    case 2:
+        return neg(sin_taylor(r));
+    default:
+        return neg(cos_taylor(r));
+    }
+}
+
+static dd cos_(dd a)
+{
+    if (!isfinite(a.hi))
+        return from(NAN);
+
+    dd r;
+    switch (reduce(a, &r))
+    {
+    case 0:
+        return cos_taylor(r);
+    case 1:
+        return neg(sin_taylor(r));
+    case 2:
+        return neg(cos_taylor(r));
+    default:
+        return sin_taylor(r);
+    }
+}
+
+static dd sinh_(dd a)
+{
+    if (fabs(a.hi) > 0.05)
+    {
+        dd e = exp_(a);
+        return ldexp_(sub(e, div_(from(1), e)), -1);
+    }
+
+    /* the exp form cancels badly near zero */
+    dd s = a, t = a;
+    dd a2 = mul(a, a);
+    for (int i = 3; i < 40; i += 2)
+    {
+        t = div_d(mul(t, a2), (double)(i - 1) * i);
+        s = add(s, t);
+        if (fabs(t.hi) <= DD_EPS)
+            break;
+    }
+    return s;
+}
+
+static dd cosh_(dd a)
+{
+    dd e = exp_(a);
+    return ldexp_(add(e, div_(from(1), e)), -1);
+}
+
+static dd asin_(dd a)
+{
+    if (fabs(a.hi) > 1)
+        return from(NAN);
+
+    dd x = from(asin(a.hi));
+    dd c = cos_(x);
+    if (c.hi == 0)
+        return x;
+    return add(x, div_(sub(a, sin_(x)), c));
+}
+
+static dd atan_(dd a)
+{
+    /* newton on tan(x) = a: x += (a - tan x) cos^2 x */
+    dd x = from(atan(a.hi));
+    dd s = sin_(x), c = cos_(x);
+    return add(x, mul(sub(mul(a, c), s), c));
+}
+
+static dd pow_(dd a, dd b)
+{
+    if (b.lo == 0 && b.hi == floor(b.hi) && fabs(b.hi) <= 1024)
+    {
+        /* integer powers by squaring, also fine for negative bases */
+        long n = fabs(b.hi);
+        dd r = from(1), base = a;
+        for (; n; n >>= 1)
+        {
+            if (n & 1)
+                r = mul(r, base);
+            base = mul(base, base);
+        }
+        return b.hi < 0 ? div_(from(1), r) : r;
+    }
+    return exp_(mul(b, log_(a)));
+}
+
+static dd floor_(dd a)
+{
+    double hi = floor(a.hi);
+    if (hi != a.hi)
+        return from(hi);
+    return dd_quick_two_sum(hi, floor(a.lo));
+}
+
+void dd_neg(dd *r, const dd *a)
+{
+    *r = neg(*a);
+}
+
+void dd_add(dd *r, const dd *a, const dd *b)
+{
+    *r = add(*a, *b);
+}
+
+void dd_sub(dd *r, const dd *a, const dd *b)
+{
+    *r = sub(*a, *b);
+}
+
+void dd_mul(dd *r, const dd *a, const dd *b)
+{
+    *r = mul(*a, *b);
+}
+
+void dd_div(dd *r, const dd *a, const dd *b)
+{
+    *r = div_(*a, *b);
+}
+
+void dd_sqrt(dd *r, const dd *a)
+{
+    *r = sqrt_(*a);
+}
+
+void dd_exp(dd *r, const dd *a)
+{
+    *r = exp_(*a);
+}
+
+void dd_log(dd *r, const dd *a)
+{
+    *r = log_(*a);
+}
+
+void dd_log10(dd *r, const dd *a)
+{
+    *r = div_(log_(*a), dd_ln10);
+}
+
+void dd_pow(dd *r, const dd *a, const dd *b)
+{
+    *r = pow_(*a, *b);
+}
+
+void dd_sin(dd *r, const dd *a)
+{
+    *r = sin_(*a);
+}
+
+void dd_cos(dd *r, const dd *a)
+{
+    *r = cos_(*a);
+}
+
+void dd_tan(dd *r, const dd *a)
+{
+    *r = div_(sin_(*a), cos_(*a));
+}
+
+void dd_sinh(dd *r, const dd *a)
+{
+    *r = sinh_(*a);
+}
+
+void dd_cosh(dd *r, const dd *a)
+{
+    *r = cosh_(*a);
+}
+
+void dd_tanh(dd *r, const dd *a)
+{
+    if (fabs(a->hi) > 20)
+        *r = from(a->hi > 0 ? 1 : -1);
+    else
+        *r = div_(sinh_(*a), cosh_(*a));
+}
+
+void dd_asin(dd *r, const dd *a)
+{
+    *r = asin_(*a);
+}
+
+void dd_acos(dd *r, const dd *a)
+{
+    *r = sub(dd_pi2, asin_(*a));
+}
+
+void dd_atan(dd *r, const dd *a)
+{
+    *r = atan_(*a);
+}
+
+void dd_atan2(dd *r, const dd *y, const dd *x)
+{
+    if (x->hi == 0)
+    {
+        if (y->hi == 0)
+            *r = from(0);
+        else
+            *r = y->hi > 0 ? dd_pi2 : neg(dd_pi2);
+        return;
+    }
+
+    dd t = atan_(div_(*y, *x));
+    if (x->hi < 0)
+        t = y->hi >= 0 ? add(t, dd_pi) : sub(t, dd_pi);
+    *r = t;
+}
+
+void dd_floor(dd *r, const dd *a)
+{
+    *r = floor_(*a);
+}
+
+void dd_ceil(dd *r, const dd *a)
+{
+    *r = neg(floor_(neg(*a)));
+}
+
+bool dd_parse(const char *s, dd *out)
+{
+    dd r = from(0);
+    int exponent = 0;
+    bool digits = false;
+
+    for (; isdigit((unsigned char)*s); ++s, digits = true)
+        r = dd_sum_d(mul_d(r, 10), *s - '0');
+    if (*s == '.')
+    {
+        for (++s; isdigit((unsigned char)*s); ++s, digits = true)
+        {
+            r = dd_sum_d(mul_d(r, 10), *s - '0');
+            --exponent;
+        }
+    }
+    if (!digits)
+        return false;
+
+    if (*s == 'e' || *s == 'E')
+    {
+        int sign = 1, e = 0;
+        ++s;
+        if (*s == '+' || *s == '-')
+            sign = *s++ == '-' ? -1 : 1;
+        if (!isdigit((unsigned char)*s))
+            return false;
+        for (; isdigit((unsigned char)*s); ++s)
+        {
+            if (e < 10000)
+                e = e * 10 + (*s - '0');
+        }
+        exponent += sign * e;
+    }
+    if (*s != '\0')
+        return false;
+
+    dd p = from(1), base = from(10);
+    for (int n = exponent < 0 ? -exponent : exponent; n; n >>= 1)
+    {
+        if (n & 1)
+            p = mul(p, base);
+        base = mul(base, base);
+    }
+    *out = exponent < 0 ? div_(r, p) : mul(r, p);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef DD_H
+#define DD_H
+
+#include <stdbool.h>
+
+/*
+ * double-double numbers: an unevaluated sum hi + lo with |lo| <= ulp(hi) / 2,
+ * giving about 106 bits of mantissa. used for deep zoom, where x differences
+ * between neighbouring pixels drop below what a double can resolve.
+ *
+ * the pointer based functions are also what jit compiled code calls, so
+ * they keep a plain C ABI that tcc and gcc agree on.
+ */
+typedef struct
+{
+    double hi, lo;
+} dd;
+
+static inline dd dd_two_sum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    return (dd){s, (a - (s - bb)) + (b - bb)};
+}
+
+static inline dd dd_quick_two_sum(double a, double b)
+{
+    double s = a + b;
+    return (dd){s, b - (s - a)};
+}
+
+/* a + b where b is a plain double */
+static inline dd dd_sum_d(dd a, double b)
+{
+    dd s = dd_two_sum(a.hi, b);
+    s.lo += a.lo;
+    return dd_quick_two_sum(s.hi, s.lo);
+}
+
+static inline double dd_to_double(dd a)
+{
+    return a.hi + a.lo;
+}
+
+void dd_neg(dd *r, const dd *a);
+void dd_add(dd *r, const dd *a, const dd *b);
+void dd_sub(dd *r, const dd *a, const dd *b);
+void dd_mul(dd *r, const dd *a, const dd *b);
+void dd_div(dd *r, const dd *a, const dd *b);
+
+void dd_sqrt(dd *r, const dd *a);
+void dd_exp(dd *r, const dd *a);
+void dd_log(dd *r, const dd *a);
+void dd_log10(dd *r, const dd *a);
+void dd_pow(dd *r, const dd *a, const dd *b);
+void dd_sin(dd *r, const dd *a);
+void dd_cos(dd *r, const dd *a);
+void dd_tan(dd *r, const dd *a);
+void dd_sinh(dd *r, const dd *a);
+void dd_cosh(dd *r, const dd *a);
+void dd_tanh(dd *r, const dd *a);
+void dd_asin(dd *r, const dd *a);
+void dd_acos(dd *r, const dd *a);
+void dd_atan(dd *r, const dd *a);
+void dd_atan2(dd *r, const dd *y, const dd *x);
+void dd_floor(dd *r, const dd *a);
+void dd_ceil(dd *r, const dd *a);
+
+/* decimal literal to the nearest double-double, false if s is not one */
+bool dd_parse(const char *s, dd *out);
+
+#endif /* DD_H */
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "ddgen.h"
+#include "expr.h"
+#include "dd.h"
+
+struct emitter
+{
+    char *out;
+    size_t size;
+    size_t len;
+    int next_id;
+    bool ok;
+};
+
+static void emit(struct emitter *e, const char *fmt, ...)
+{
+    if (!e->ok)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(e->out + e->len, e->size - e->len, fmt, args);
+    va_end(args);
+
+    if (n < 0 || (size_t)n >= e->size - e->len)
+    {
+        e->ok = false;
+        return;
+    }
+    e->len += n;
+}
+
+/* returns the id of the temporary v<id> holding the value of node */
+static int emit_node(struct emitter *e, const struct expr *node)
+{
+    int a, b, r;
+    dd value;
+
+    /* left to the compiler as in graph_func, where 1/2 is 0 */
+    if (node->integer)
+    {
+        char text[1024];
+        if (!expr_format_integer(node, text, sizeof(text)))
+        {
+            e->ok = false;
+            return 0;
+        }
+        r = e->next_id++;
+        emit(e, "dd v%d = {%s, 0.0};", r, text);
+        return r;
+    }
+
+    switch (node->kind)
+    {
+    case EXPR_X:
+        return 0;
+
+    case EXPR_NUM:
+        /* literals are re-read so 0.1 is not just the double nearest to it */
+        if (!dd_parse(node->text, &value))
+            value = (dd){node->value, 0};
+        r = e->next_id++;
+        emit(e, "dd v%d = {%.17g, %.17g};", r, value.hi, value.lo);
+        return r;
+
+    case EXPR_NEG:
+        a = emit_node(e, node->args[0]);
+        r = e->next_id++;
+        emit(e, "dd v%d = {-v%d.hi, -v%d.lo};", r, a, a);
+        return r;
+
+    case EXPR_ADD:
+    case EXPR_SUB:
+    case EXPR_MUL:
+    case EXPR_DIV:
+    {
+        static const char *ops[] = {
+            [EXPR_ADD] = "dd_add",
+            [EXPR_SUB] = "dd_sub",
+            [EXPR_MUL] = "dd_mul",
+            [EXPR_DIV] = "dd_div",
+        };
+        a = emit_node(e, node->args[0]);
+        b = emit_node(e, node->args[1]);
+        r = e->next_id++;
+        emit(e, "dd v%d;%s(&v%d, &v%d, &v%d);", r, ops[node->kind], r, a, b);
+        return r;
+    }
+
+    case EXPR_CALL:
+        a = emit_node(e, node->args[0]);
+        if (node->argc == 1)
+        {
+            r = e->next_id++;
+            emit(e, "dd v%d;dd_%s(&v%d, &v%d);", r, node->text, r, a);
+            return r;
+        }
+        b = emit_node(e, node->args[1]);
+        r = e->next_id++;
+        emit(e, "dd v%d;dd_%s(&v%d, &v%d, &v%d);", r, node->text, r, a, b);
+        return r;
+
+    case EXPR_T:
+        r = e->next_id++;
+        emit(e, "dd v%d = {t, 0.0};", r);
+        return r;
+
+    case EXPR_Z:
+    case EXPR_I:
+        /* complex only */
+        break;
+    }
+
+    e->ok = false;
+    return 0;
+}
+
+bool dd_emit(const char *expr, char *out, size_t out_size)
+{
+    if (out_size == 0)
+        return false;
+    out[0] = '\0';
+
+    struct expr *tree = expr_parse(expr);
+    if (!tree)
+        return false;
+
+    struct emitter e = {out, out_size, 0, 1, true};
+    emit(&e, "dd v0 = *x;");
+    int r = emit_node(&e, tree);
+    emit(&e, "*y = v%d;", r);
+
+    expr_free(tree);
+    return e.ok;
+}
@@ -0,0 +1,18 @@
+#ifndef DDGEN_H
+#define DDGEN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * double-double lowering of a graph expression.
+ *
+ * writes the C body of
+ *     void graph_func_dd(const dd *x, dd *y, const double t)
+ * into out, with every operation turned into a call to the dd_* functions
+ * from dd.h. returns false for anything expr_parse rejects (or if out is
+ * too small), deep zoom is then unavailable for the expression.
+ */
+bool dd_emit(const char *expr, char *out, size_t out_size);
+
+#endif /* DDGEN_H */
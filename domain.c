@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "domain.h"
+#include "pool.h"
+#include "watchdog.h"
+
+#define TILE 64
+#define CACHE_SLOTS 1024 /* power of two */
+#define PROBE 8          /* slots a tile may live in */
+
+/* past this the global pixel grid no longer fits the tile keys */
+#define MAX_PIXEL_INDEX 1e15
+
+#define TWO_PI 6.283185307179586
+
+struct tile
+{
+    long long tx, ty;
+    unsigned int generation;
+    unsigned int stamp; /* frame the tile was last drawn in */
+    bool valid;
+    unsigned int pixels[TILE * TILE];
+};
+
+/* one visible tile for the current frame */
+struct tile_job
+{
+    long long tx, ty;
+    struct tile *slot; /* NULL when every candidate slot is taken this frame */
+};
+
+struct frame
+{
+    struct domain_cache *cache;
+    jit_complex_row fn;
+    double time;
+    unsigned int *pixels;
+    int width, height;
+    long long base_x, base_y; /* global pixel at screen (0, 0) */
+    double scale;
+    struct tile_job *jobs;
+};
+
+void domain_reset(struct domain_cache *cache)
+{
+    ++cache->generation;
+}
+
+void domain_free(struct domain_cache *cache)
+{
+    free(cache->tiles);
+    cache->tiles = NULL;
+}
+
+static long long floor_div(long long a, long long b)
+{
+    long long q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static unsigned int slot_hash(long long tx, long long ty)
+{
+    unsigned long long h = (unsigned long long)tx * 0x9e3779b97f4a7c15ull ^
+                           (unsigned long long)ty * 0xc2b2ae3d27d4eb4full;
+    return (unsigned int)(h >> 32);
+}
+
+/* the cached tile for (tx, ty), or a slot to render it into */
+static struct tile *find_slot(struct domain_cache *cache, long long tx, long long ty)
+{
+    unsigned int generation = cache->generation, stamp = cache->stamp;
+    unsigned int h = slot_hash(tx, ty);
+    struct tile *victim = NULL;
+    unsigned int victim_age = 0;
+
+    for (int i = 0; i < PROBE; ++i)
+    {
+        struct tile *t = &cache->tiles[(h + i) & (CACHE_SLOTS - 1)];
+        if (t->generation == generation && t->tx == tx && t->ty == ty)
+        {
+            t->stamp = stamp;
+            return t;
+        }
+        if (t->stamp == stamp)
+            continue;
+
+        /* stale tiles first, then the least recently drawn */
+        unsigned int age = t->generation == generation ? t->stamp : 0;
+        if (!victim || age < victim_age)
+        {
+            victim = t;
+            victim_age = age;
+        }
+    }
+
+    if (victim)
+    {
+        victim->tx = tx;
+        victim->ty = ty;
+        victim->generation = generation;
+        victim->stamp = stamp;
+        victim->valid = false;
+    }
+    return victim;
+}
+
+/* arg w in turns and log2 |w|, the libm calls kept out of the arithmetic pass */
+static void polar_row(const double *w, double *arg, double *mag)
+{
+    for (int k = 0; k < TILE; ++k)
+    {
+        double re = w[2 * k], im = w[2 * k + 1];
+        arg[k] = atan2(im, re) / TWO_PI;
+        mag[k] = log2(hypot(re, im));
+    }
+}
+
+/*
+ * hue from arg, value cycling with log2 |w| so level sets of |f| show up
+ * as bands, hsv with full saturation to rgb. nan and infinity come out
+ * black. two pixels at a time with SSE2 where it is available, it gives
+ * the same pixels as the scalar loop.
+ */
+#ifdef __SSE2__
+static void hsv_row(const double *arg, const double *mag, unsigned int *out)
+{
+    const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1), four = _mm_set1_pd(4), six = _mm_set1_pd(6);
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffll));
+    const __m128d int_range = _mm_set1_pd(2147483648.0);
+
+    for (int k = 0; k < TILE; k += 2)
+    {
+        __m128d h = _mm_loadu_pd(arg + k), m = _mm_loadu_pd(mag + k);
+
+        /* floor by truncation, fine for every |m| < 2^31 and |m| stays far below */
+        __m128d fl = _mm_cvtepi32_pd(_mm_cvttpd_epi32(m));
+        fl = _mm_sub_pd(fl, _mm_and_pd(_mm_cmpgt_pd(fl, m), one));
+        __m128d v = _mm_add_pd(_mm_set1_pd(0.6), _mm_mul_pd(_mm_set1_pd(0.4), _mm_sub_pd(m, fl)));
+        v = _mm_and_pd(v, _mm_cmplt_pd(_mm_and_pd(m, abs_mask), int_range));
+
+        h = _mm_add_pd(h, _mm_and_pd(_mm_cmplt_pd(h, zero), one));
+        __m128d h6 = _mm_and_pd(_mm_mul_pd(h, six), _mm_cmpeq_pd(h, h));
+
+        __m128i rgba = _mm_set1_epi32(0xff);
+        for (int c = 0; c < 3; ++c)
+        {
+            __m128d n = _mm_add_pd(_mm_set1_pd(5 - 2 * c), h6);
+            n = _mm_sub_pd(n, _mm_and_pd(_mm_cmpge_pd(n, six), six));
+            __m128d t = _mm_min_pd(n, _mm_sub_pd(four, n));
+            t = _mm_max_pd(_mm_min_pd(t, one), zero);
+            __m128d level = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(v, _mm_sub_pd(one, t)), _mm_set1_pd(255)),
+                                       _mm_set1_pd(0.5));
+            __m128i channel = _mm_cvttpd_epi32(level);
+            rgba = _mm_or_si128(rgba, _mm_slli_epi32(channel, 24 - 8 * c));
+        }
+        _mm_storel_epi64((__m128i *)(out + k), rgba);
+    }
+}
+#else
+static void hsv_row(const double *arg, const double *mag, unsigned int *out)
+{
+    for (int k = 0; k < TILE; ++k)
+    {
+        double h = arg[k] < 0 ? arg[k] + 1 : arg[k];
+        double value = 0.6 + 0.4 * (mag[k] - floor(mag[k]));
+        double v = value == value ? value : 0;
+        double h6 = h == h ? h * 6 : 0;
+        unsigned int channel[3];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            /* n = 5, 3, 1 for r, g, b */
+            double n = 5 - 2 * c + h6;
+            n = n >= 6 ? n - 6 : n;
+            double t = n < 4 - n ? n : 4 - n;
+            t = t < 0 ? 0 : (t > 1 ? 1 : t);
+            channel[c] = (unsigned int)(v * (1 - t) * 255 + 0.5);
+        }
+        out[k] = channel[0] << 24 | channel[1] << 16 | channel[2] << 8 | 0xff;
+    }
+}
+#endif
+
+static void color_row(const double *w, unsigned int *out)
+{
+    double arg[TILE], mag[TILE];
+    polar_row(w, arg, mag);
+    hsv_row(arg, mag, out);
+}
+
+static void render_tile(const struct frame *f, long long tx, long long ty, unsigned int *dst)
+{
+    double w[2 * TILE];
+    double step = 1 / f->scale;
+    double re = (tx * TILE + 0.5) * step;
+
+    for (int r = 0; r < TILE && !watchdog_cancelled(); ++r)
+    {
+        /* screen y grows downwards, the imaginary axis upwards */
+        double im = -(ty * TILE + r + 0.5) * step;
+        f->fn(re, im, step, TILE, f->time, w);
+        color_row(w, dst + r * TILE);
+    }
+}
+
+static void tile_task(void *ctx, int index)
+{
+    const struct frame *f = ctx;
+    struct tile_job *job = &f->jobs[index];
+
+    if (watchdog_cancelled())
+        return;
+
+    unsigned int scratch[TILE * TILE];
+    const unsigned int *src = scratch;
+    if (job->slot)
+    {
+        if (!job->slot->valid)
+        {
+            render_tile(f, job->tx, job->ty, job->slot->pixels);
+            /* a cancelled tile is left for the next frame to redo */
+            job->slot->valid = !watchdog_cancelled();
+        }
+        src = job->slot->pixels;
+    }
+    else
+        render_tile(f, job->tx, job->ty, scratch);
+
+    /* clip the tile against the screen */
+    long long x0 = job->tx * TILE - f->base_x, y0 = job->ty * TILE - f->base_y;
+    int from_x = x0 < 0 ? -x0 : 0;
+    int to_x = x0 + TILE > f->width ? f->width - x0 : TILE;
+    int from_y = y0 < 0 ? -y0 : 0;
+    int to_y = y0 + TILE > f->height ? f->height - y0 : TILE;
+
+    for (int r = from_y; r < to_y; ++r)
+        memcpy(&f->pixels[(y0 + r) * f->width + x0 + from_x], &src[r * TILE + from_x],
+               (to_x - from_x) * sizeof(*src));
+}
+
+void domain_render(struct domain_cache *cache, jit_complex_row fn, double time, unsigned int *pixels,
+                   int width, int height, double center_x, double center_y, double scale)
+{
+    double left = floor(center_x * scale - width / 2.0);
+    double top = floor(-center_y * scale - height / 2.0);
+    if (!(fabs(left) < MAX_PIXEL_INDEX && fabs(top) < MAX_PIXEL_INDEX))
+    {
+        memset(pixels, 0, (size_t)width * height * sizeof(*pixels));
+        return;
+    }
+
+    if (!cache->tiles)
+    {
+        cache->tiles = calloc(CACHE_SLOTS, sizeof(*cache->tiles));
+        /* zeroed slots carry generation 0, which is never current */
+        ++cache->generation;
+    }
+    if (scale != cache->last_scale)
+    {
+        cache->last_scale = scale;
+        ++cache->generation;
+    }
+    ++cache->stamp;
+
+    struct frame f = {cache, fn, time, pixels, width, height, left, top, scale, NULL};
+    long long tx0 = floor_div(f.base_x, TILE), tx1 = floor_div(f.base_x + width - 1, TILE);
+    long long ty0 = floor_div(f.base_y, TILE), ty1 = floor_div(f.base_y + height - 1, TILE);
+    int count = (tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+
+    f.jobs = malloc(count * sizeof(*f.jobs));
+    if (!f.jobs)
+    {
+        memset(pixels, 0, (size_t)width * height * sizeof(*pixels));
+        return;
+    }
+    int n = 0;
+    for (long long ty = ty0; ty <= ty1; ++ty)
+    {
+        for (long long tx = tx0; tx <= tx1; ++tx)
+        {
+            f.jobs[n].tx = tx;
+            f.jobs[n].ty = ty;
+            f.jobs[n].slot = cache->tiles ? find_slot(cache, tx, ty) : NULL;
+            ++n;
+        }
+    }
+
+    pool_for(count, tile_task, &f);
+    free(f.jobs);
+}
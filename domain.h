@@ -0,0 +1,29 @@
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#include "jit.h"
+
+/* tiles kept between frames, owned by whichever thread renders. zero initialize */
+struct domain_cache
+{
+    struct tile *tiles;
+    unsigned int generation;
+    unsigned int stamp; /* frames drawn */
+    double last_scale;
+};
+
+/* drop every cached tile, call after the function changes */
+void domain_reset(struct domain_cache *cache);
+void domain_free(struct domain_cache *cache);
+
+/*
+ * domain coloring of f at time over the view centred on (center_x, center_y)
+ * at scale pixels per unit: hue is arg f(z), brightness cycles with log2 |f(z)|.
+ * the plane is cut into tiles on a grid fixed to the world, evaluated on
+ * the thread pool and cached, so a pan only evaluates the tiles it exposes.
+ * a change of scale starts over.
+ */
+void domain_render(struct domain_cache *cache, jit_complex_row fn, double time, unsigned int *pixels,
+                   int width, int height, double center_x, double center_y, double scale);
+
+#endif /* DOMAIN_H */
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+#include <SDL2/SDL.h>
+
+#include "eval.h"
+
+/* pixels a sample may be off by before moving to a wider type */
+#define PIXEL_TOLERANCE 0.25
+#define PROBE_COUNT 64
+/* rounds eval_float_faster times each precision, the fastest one counts */
+#define TIMING_ROUNDS 5
+
+enum eval_precision eval_choose(const struct jit_funcs *funcs, double x_min, double x_max,
+                                double y_min, double y_max, double scale)
+{
+    /* pixels covered by one unit of relative rounding error in x or a visible y */
+    double extent = fmax(fmax(fabs(x_min), fabs(x_max)), fmax(fabs(y_min), fabs(y_max))) * scale;
+
+    if (extent * DBL_EPSILON > PIXEL_TOLERANCE)
+        return funcs->graph_func_dd ? EVAL_DD : EVAL_DOUBLE;
+
+    if (!funcs->graph_func_batch_f || !(extent * FLT_EPSILON <= PIXEL_TOLERANCE) ||
+        !(fmax(fabs(x_min), fabs(x_max)) < FLT_MAX))
+        return EVAL_DOUBLE;
+
+    double xs[PROBE_COUNT], ys[PROBE_COUNT], ys_f[PROBE_COUNT];
+    for (int i = 0; i < PROBE_COUNT; ++i)
+        xs[i] = x_min + (x_max - x_min) * (i + 0.5) / PROBE_COUNT;
+
+    eval_batch(funcs, EVAL_DOUBLE, xs, ys, PROBE_COUNT);
+    eval_batch(funcs, EVAL_FLOAT, xs, ys_f, PROBE_COUNT);
+
+    /* only samples on or near the screen have to agree */
+    double margin = y_max - y_min;
+    for (int i = 0; i < PROBE_COUNT; ++i)
+    {
+        if (!(ys[i] >= y_min - margin && ys[i] <= y_max + margin))
+            continue;
+        if (!isfinite(ys_f[i]) || fabs(ys_f[i] - ys[i]) * scale > PIXEL_TOLERANCE)
+            return EVAL_DOUBLE;
+    }
+
+    return EVAL_FLOAT;
+}
+
+bool eval_float_faster(const struct jit_funcs *funcs, double x_min, double x_max)
+{
+    if (!funcs->graph_func_batch_f)
+        return false;
+
+    double xs[EVAL_BATCH], ys[EVAL_BATCH];
+    for (int i = 0; i < EVAL_BATCH; ++i)
+        xs[i] = x_min + (x_max - x_min) * (i + 0.5) / EVAL_BATCH;
+
+    Uint64 best[2] = {(Uint64)-1, (Uint64)-1};
+    for (int round = 0; round < TIMING_ROUNDS; ++round)
+    {
+        for (int p = 0; p < 2; ++p)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            eval_batch(funcs, p ? EVAL_FLOAT : EVAL_DOUBLE, xs, ys, EVAL_BATCH);
+            Uint64 ticks = SDL_GetPerformanceCounter() - start;
+            if (ticks < best[p])
+                best[p] = ticks;
+        }
+    }
+    return best[1] < best[0];
+}
+
+void eval_batch(const struct jit_funcs *funcs, enum eval_precision precision,
+                const double *xs, double *ys, int n)
+{
+    if (precision != EVAL_FLOAT || !funcs->graph_func_batch_f)
+    {
+        funcs->graph_func_batch(xs, ys, n, funcs->time);
+        return;
+    }
+
+    float xs_f[EVAL_BATCH], ys_f[EVAL_BATCH];
+    for (int start = 0; start < n; start += EVAL_BATCH)
+    {
+        int count = n - start < EVAL_BATCH ? n - start : EVAL_BATCH;
+        for (int i = 0; i < count; ++i)
+            xs_f[i] = xs[start + i];
+
+        funcs->graph_func_batch_f(xs_f, ys_f, count, (float)funcs->time);
+
+        for (int i = 0; i < count; ++i)
+            ys[start + i] = ys_f[i];
+    }
+}
+
+void eval_batch_dd(const struct jit_funcs *funcs, dd x_base, const double *offsets,
+                   dd y_shift, double *ys, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        dd x = dd_sum_d(x_base, offsets[i]);
+        dd y;
+        funcs->graph_func_dd(&x, &y, funcs->time);
+        dd_add(&y, &y, &y_shift);
+        ys[i] = dd_to_double(y);
+    }
+}
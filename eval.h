@@ -0,0 +1,50 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdbool.h>
+
+#include "jit.h"
+#include "dd.h"
+
+#define EVAL_BATCH 1024
+
+enum eval_precision
+{
+    EVAL_DOUBLE,
+    EVAL_FLOAT,
+    EVAL_DD,
+};
+
+/*
+ * picks the cheapest precision that still puts every sample on the right
+ * pixel for the view [x_min, x_max] x [y_min, y_max] at scale pixels per
+ * unit. double-double is only used once rounding to double would move a
+ * sample. float is ruled out up front when rounding x or y alone moves a
+ * sample, otherwise a handful of probe points are evaluated both ways and
+ * compared in screen space.
+ */
+enum eval_precision eval_choose(const struct jit_funcs *funcs, double x_min, double x_max,
+                                double y_min, double y_max, double scale);
+
+/*
+ * times one batch over [x_min, x_max] in float and in double, best of a
+ * few rounds each. false when float takes as long or longer, or the
+ * expression has no float path, the float path is not worth its
+ * rounding then. runs the function, so call it where a runaway one is
+ * watched.
+ */
+bool eval_float_faster(const struct jit_funcs *funcs, double x_min, double x_max);
+
+/* ys[i] = f(xs[i]) in double or float */
+void eval_batch(const struct jit_funcs *funcs, enum eval_precision precision,
+                const double *xs, double *ys, int n);
+
+/*
+ * ys[i] = f(x_base + offsets[i]) + y_shift, evaluated in double-double and
+ * only rounded at the end, so the results stay resolvable relative to the
+ * view even where x and y themselves are huge.
+ */
+void eval_batch_dd(const struct jit_funcs *funcs, dd x_base, const double *offsets,
+                   dd y_shift, double *ys, int n);
+
+#endif /* EVAL_H */
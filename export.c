@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "export.h"
+#include "watchdog.h"
+
+/* curve samples per pixel column, five times what plot_render takes */
+#define SAMPLES_PER_PIXEL 1000
+/* how far the simplified curve may stray from the samples, in pixels */
+#define TOLERANCE 0.1
+/* samples simplified at once, the only buffer the curve passes through */
+#define WINDOW 32768
+/* neighbouring samples further apart than this get checked for a jump */
+#define JUMP_PX 2.0
+/* bisections spent deciding whether a step is a jump */
+#define JUMP_STEPS 40
+/* the curve is followed this many view heights above and below the view */
+#define MARGIN 1.0
+
+#define CURVE_WIDTH 1.5
+
+enum format
+{
+    FORMAT_SVG,
+    FORMAT_PDF,
+};
+
+/* PDF objects: catalog, page tree, page, content stream and its length */
+#define PDF_OBJECTS 5
+
+struct writer
+{
+    FILE *fp;
+    enum format format;
+    int height;
+    long stream_start;
+    long offsets[PDF_OBJECTS + 1];
+    int column; /* points on the current SVG line */
+    unsigned long points;
+};
+
+static void writer_open(struct writer *w, int width, int height, double origin_x, double origin_y)
+{
+    FILE *fp = w->fp;
+    w->height = height;
+
+    if (w->format == FORMAT_SVG)
+    {
+        fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+                width, height, width, height);
+        fprintf(fp, "<rect width=\"%d\" height=\"%d\" fill=\"white\"/>\n", width, height);
+        fprintf(fp, "<g fill=\"none\" stroke=\"#737373\" stroke-width=\"1\">\n");
+        if (origin_y >= 0 && origin_y <= height)
+            fprintf(fp, "<path d=\"M0 %.2f H%d\"/>\n", origin_y, width);
+        if (origin_x >= 0 && origin_x <= width)
+            fprintf(fp, "<path d=\"M%.2f 0 V%d\"/>\n", origin_x, height);
+        fprintf(fp, "</g>\n");
+        fprintf(fp, "<g fill=\"none\" stroke=\"black\" stroke-width=\"%g\" stroke-linejoin=\"round\""
+                    " stroke-linecap=\"round\">\n", CURVE_WIDTH);
+        return;
+    }
+
+    /* the content stream goes out before its length is known, so that is an object of its own */
+    fprintf(fp, "%%PDF-1.4\n%%\xe2\xe3\xcf\xd3\n");
+    w->offsets[1] = ftell(fp);
+    fprintf(fp, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    w->offsets[2] = ftell(fp);
+    fprintf(fp, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+    w->offsets[3] = ftell(fp);
+    fprintf(fp, "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %d %d] /Contents 4 0 R >>\nendobj\n",
+            width, height);
+    w->offsets[4] = ftell(fp);
+    fprintf(fp, "4 0 obj\n<< /Length 5 0 R >>\nstream\n");
+    w->stream_start = ftell(fp);
+
+    /* PDF has y going up */
+    fprintf(fp, "0.45 G 1 w\n");
+    if (origin_y >= 0 && origin_y <= height)
+        fprintf(fp, "0 %.2f m %d %.2f l S\n", height - origin_y, width, height - origin_y);
+    if (origin_x >= 0 && origin_x <= width)
+        fprintf(fp, "%.2f 0 m %.2f %d l S\n", origin_x, origin_x, height);
+    fprintf(fp, "0 G %g w 1 J 1 j\n", CURVE_WIDTH);
+}
+
+static void writer_point(struct writer *w, double x, double y, bool first)
+{
+    ++w->points;
+    if (w->format == FORMAT_PDF)
+    {
+        fprintf(w->fp, "%.2f %.2f %c\n", x, w->height - y, first ? 'm' : 'l');
+        return;
+    }
+
+    if (first)
+    {
+        fprintf(w->fp, "<path d=\"M%.2f %.2f L", x, y);
+        w->column = 0;
+        return;
+    }
+    fprintf(w->fp, w->column == 8 ? "\n%.2f %.2f" : " %.2f %.2f", x, y);
+    w->column = w->column == 8 ? 1 : w->column + 1;
+}
+
+static void writer_end_path(struct writer *w)
+{
+    fprintf(w->fp, w->format == FORMAT_PDF ? "S\n" : "\"/>\n");
+}
+
+static bool writer_close(struct writer *w)
+{
+    FILE *fp = w->fp;
+
+    if (w->format == FORMAT_SVG)
+        fprintf(fp, "</g>\n</svg>\n");
+    else
+    {
+        long length = ftell(fp) - w->stream_start;
+        fprintf(fp, "endstream\nendobj\n");
+        w->offsets[5] = ftell(fp);
+        fprintf(fp, "5 0 obj\n%ld\nendobj\n", length);
+
+        long xref = ftell(fp);
+        fprintf(fp, "xref\n0 %d\n0000000000 65535 f \n", PDF_OBJECTS + 1);
+        for (int i = 1; i <= PDF_OBJECTS; ++i)
+            fprintf(fp, "%010ld 00000 n \n", w->offsets[i]);
+        fprintf(fp, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", PDF_OBJECTS + 1, xref);
+    }
+
+    bool ok = !ferror(fp);
+    return fclose(fp) == 0 && ok;
+}
+
+/*
+ * douglas-peucker over windows of WINDOW samples. each window keeps its
+ * first and last sample and the last one starts the next window, so the
+ * error bound holds over the whole polyline while only one window is held.
+ */
+struct simplifier
+{
+    struct writer *out;
+    double x[WINDOW], y[WINDOW];
+    bool keep[WINDOW];
+    int stack_lo[WINDOW], stack_hi[WINDOW];
+    int count;
+    bool started; /* x[0] has been written already */
+};
+
+/* distance from p to the segment a-b */
+static double segment_distance(double px, double py, double ax, double ay, double bx, double by)
+{
+    double dx = bx - ax, dy = by - ay;
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return hypot(px - (ax + t * dx), py - (ay + t * dy));
+}
+
+static void simplify(struct simplifier *s)
+{
+    int n = s->count;
+    memset(s->keep, 0, n * sizeof(*s->keep));
+    s->keep[0] = s->keep[n - 1] = true;
+
+    int top = 0;
+    s->stack_lo[top] = 0;
+    s->stack_hi[top++] = n - 1;
+    while (top)
+    {
+        --top;
+        int a = s->stack_lo[top], b = s->stack_hi[top];
+
+        int worst = -1;
+        double worst_distance = TOLERANCE;
+        for (int i = a + 1; i < b; ++i)
+        {
+            double d = segment_distance(s->x[i], s->y[i], s->x[a], s->y[a], s->x[b], s->y[b]);
+            if (d > worst_distance)
+            {
+                worst_distance = d;
+                worst = i;
+            }
+        }
+        if (worst < 0)
+            continue;
+
+        /* pending ranges never overlap, so there are fewer than WINDOW of them */
+        s->keep[worst] = true;
+        s->stack_lo[top] = a;
+        s->stack_hi[top++] = worst;
+        s->stack_lo[top] = worst;
+        s->stack_hi[top++] = b;
+    }
+}
+
+static void flush(struct simplifier *s)
+{
+    simplify(s);
+    for (int i = s->started ? 1 : 0; i < s->count; ++i)
+    {
+        if (s->keep[i])
+            writer_point(s->out, s->x[i], s->y[i], i == 0);
+    }
+
+    s->x[0] = s->x[s->count - 1];
+    s->y[0] = s->y[s->count - 1];
+    s->count = 1;
+    s->started = true;
+}
+
+static void add_point(struct simplifier *s, double x, double y)
+{
+    if (s->count == WINDOW)
+        flush(s);
+    s->x[s->count] = x;
+    s->y[s->count] = y;
+    ++s->count;
+}
+
+static void end_polyline(struct simplifier *s)
+{
+    /* a lone sample is no line */
+    if (s->count > 1)
+        flush(s);
+    if (s->started)
+        writer_end_path(s->out);
+    s->count = 0;
+    s->started = false;
+}
+
+struct sampler
+{
+    const struct jit_funcs *funcs;
+    const struct plot_view *view;
+    enum eval_precision precision;
+    double cx, cy;
+};
+
+/* screen y of the curve at world offsets xs from the centre */
+static void sample(const struct sampler *s, const double *xs, double *ys, int n)
+{
+    const struct plot_view *view = s->view;
+    if (s->precision == EVAL_DD)
+    {
+        dd y_shift = {-view->center_y.hi, -view->center_y.lo};
+        eval_batch_dd(s->funcs, view->center_x, xs, y_shift, ys, n);
+    }
+    else
+    {
+        double x[EVAL_BATCH];
+        for (int i = 0; i < n; ++i)
+            x[i] = s->cx + xs[i];
+        eval_batch(s->funcs, s->precision, x, ys, n);
+        for (int i = 0; i < n; ++i)
+            ys[i] -= s->cy;
+    }
+
+    for (int i = 0; i < n; ++i)
+        ys[i] = view->height / 2.0 - ys[i] * view->scale;
+}
+
+/*
+ * whether the curve jumps between offsets a and b rather than just being
+ * steep. the half carrying most of the step is kept, a continuous curve
+ * gets flatter with every halving while a jump stays as tall.
+ */
+static bool is_jump(const struct sampler *s, double a, double ya, double b, double yb)
+{
+    for (int i = 0; i < JUMP_STEPS; ++i)
+    {
+        double m = a + (b - a) / 2, ym;
+        if (m == a || m == b)
+            break;
+        sample(s, &m, &ym, 1);
+        if (!isfinite(ym))
+            return true;
+
+        if (fabs(ym - ya) > fabs(yb - ym))
+        {
+            b = m;
+            yb = ym;
+        }
+        else
+        {
+            a = m;
+            ya = ym;
+        }
+        if (fabs(yb - ya) <= JUMP_PX)
+            return false;
+    }
+    return true;
+}
+
+bool export_vector(const struct jit_funcs *funcs, const struct plot_view *view, const char *path)
+{
+    size_t len = strlen(path);
+    struct writer w = {0};
+    w.format = len >= 4 && !strcmp(path + len - 4, ".pdf") ? FORMAT_PDF : FORMAT_SVG;
+
+    struct simplifier *s = malloc(sizeof(*s));
+    if (!s)
+    {
+        printf("Out of memory exporting %s\n", path);
+        return false;
+    }
+    w.fp = fopen(path, "wb");
+    if (!w.fp)
+    {
+        printf("Can't open %s for writing\n", path);
+        free(s);
+        return false;
+    }
+    s->out = &w;
+    s->count = 0;
+    s->started = false;
+
+    int width = view->width, height = view->height;
+    double scale = view->scale;
+    double cx = dd_to_double(view->center_x);
+    double cy = dd_to_double(view->center_y);
+    writer_open(&w, width, height, width / 2.0 - cx * scale, height / 2.0 + cy * scale);
+
+    /*
+     * double, or double-double once its rounding reaches TOLERANCE. never
+     * float: eval_choose trades that in at a quarter pixel, too loose here.
+     */
+    double half_w = width / 2.0 / scale, half_h = height / 2.0 / scale;
+    double extent = fmax(fabs(cx) + half_w, fabs(cy) + half_h) * scale;
+    enum eval_precision precision =
+        funcs->graph_func_dd && extent * DBL_EPSILON > TOLERANCE ? EVAL_DD : EVAL_DOUBLE;
+    struct sampler sampler = {funcs, view, precision, cx, cy};
+
+    double top = -MARGIN * height, bottom = (1 + MARGIN) * height;
+    double prev_x = 0, prev_sx = 0, prev_sy = NAN;
+    bool prev_visible = false;
+
+    /* one sample past the last column so the curve reaches the right edge */
+    int total = width * SAMPLES_PER_PIXEL + 1;
+    double xs[EVAL_BATCH], ys[EVAL_BATCH];
+    bool cancelled = false;
+    for (int start = 0; start < total; start += EVAL_BATCH)
+    {
+        if (watchdog_cancelled())
+        {
+            cancelled = true;
+            break;
+        }
+
+        int n = total - start < EVAL_BATCH ? total - start : EVAL_BATCH;
+        for (int i = 0; i < n; ++i)
+            xs[i] = ((double)(start + i) / SAMPLES_PER_PIXEL - width / 2.0) / scale;
+        sample(&sampler, xs, ys, n);
+
+        for (int i = 0; i < n; ++i)
+        {
+            double sx = (double)(start + i) / SAMPLES_PER_PIXEL, sy = ys[i];
+            bool visible = sy >= top && sy <= bottom;
+            bool joined = isfinite(sy) && isfinite(prev_sy) &&
+                          !(fabs(sy - prev_sy) > JUMP_PX && is_jump(&sampler, prev_x, prev_sy, xs[i], sy));
+
+            /* the samples just outside the view are kept so lines run off its edge */
+            if (!joined)
+                end_polyline(s);
+            if (visible || (joined && prev_visible))
+            {
+                if (joined && !prev_visible)
+                    add_point(s, prev_sx, prev_sy);
+                add_point(s, sx, sy);
+            }
+            if (!visible)
+                end_polyline(s);
+
+            prev_x = xs[i];
+            prev_sx = sx;
+            prev_sy = sy;
+            prev_visible = visible;
+        }
+    }
+    end_polyline(s);
+    free(s);
+
+    unsigned long points = w.points;
+    if (cancelled)
+    {
+        /* half a curve is worse than none */
+        writer_close(&w);
+        remove(path);
+        printf("Export of %s ran out of time\n", path);
+        return false;
+    }
+    if (!writer_close(&w))
+    {
+        printf("Error writing %s\n", path);
+        return false;
+    }
+    printf("Exported %lu of %d samples to %s\n", points, total, path);
+    return true;
+}
@@ -0,0 +1,20 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+
+#include "jit.h"
+#include "plot.h"
+
+/*
+ * writes the curve of funcs in view as a vector image, PDF when path ends
+ * in .pdf and SVG otherwise, in device pixels of the view along with the
+ * two axes. the curve is sampled far denser than plot_render, cut where
+ * it jumps or leaves the view and simplified to within a fraction of a
+ * pixel. everything is written as it is sampled, so memory use does not
+ * depend on the number of samples. sampling stops at watchdog_cancelled,
+ * the unfinished file is removed then.
+ */
+bool export_vector(const struct jit_funcs *funcs, const struct plot_view *view, const char *path);
+
+#endif /* EXPORT_H */
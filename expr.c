@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "expr.h"
+
+struct parser
+{
+    const char *p;
+    bool ok;
+};
+
+static const struct
+{
+    const char *name;
+    int argc;
+} functions[] = {
+    {"sin", 1}, {"cos", 1}, {"tan", 1},
+    {"sinh", 1}, {"cosh", 1}, {"tanh", 1},
+    {"asin", 1}, {"acos", 1}, {"atan", 1}, {"atan2", 2},
+    {"exp", 1}, {"log", 1}, {"log10", 1}, {"pow", 2},
+    {"sqrt", 1}, {"ceil", 1}, {"floor", 1},
+};
+
+static struct expr *node(struct parser *ps, enum expr_kind kind, struct expr *a, struct expr *b)
+{
+    struct expr *e = calloc(1, sizeof(*e));
+    if (!e)
+    {
+        ps->ok = false;
+        expr_free(a);
+        expr_free(b);
+        return NULL;
+    }
+    e->kind = kind;
+    e->args[0] = a;
+    e->args[1] = b;
+    e->argc = (a != NULL) + (b != NULL);
+    if (kind == EXPR_NEG || kind == EXPR_ADD || kind == EXPR_SUB || kind == EXPR_MUL || kind == EXPR_DIV)
+        e->integer = a->integer && (!b || b->integer);
+    return e;
+}
+
+static void skip_space(struct parser *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+        ++ps->p;
+}
+
+static bool accept(struct parser *ps, char c)
+{
+    skip_space(ps);
+    if (*ps->p != c)
+        return false;
+    ++ps->p;
+    return true;
+}
+
+static struct expr *fail(struct parser *ps, struct expr *a, struct expr *b)
+{
+    ps->ok = false;
+    expr_free(a);
+    expr_free(b);
+    return NULL;
+}
+
+static struct expr *parse_sum(struct parser *ps);
+
+static struct expr *parse_call(struct parser *ps, const char *name)
+{
+    int argc = -1;
+    for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]); ++i)
+    {
+        if (!strcmp(functions[i].name, name))
+            argc = functions[i].argc;
+    }
+    if (argc < 0)
+        return fail(ps, NULL, NULL);
+
+    struct expr *a = parse_sum(ps);
+    struct expr *b = NULL;
+    if (argc == 2 && (!accept(ps, ',') || !(b = parse_sum(ps))))
+        return fail(ps, a, b);
+    if (!a || !accept(ps, ')'))
+        return fail(ps, a, b);
+
+    struct expr *e = node(ps, EXPR_CALL, a, b);
+    if (e)
+        strcpy(e->text, name);
+    return e;
+}
+
+static struct expr *parse_primary(struct parser *ps)
+{
+    skip_space(ps);
+
+    if (accept(ps, '('))
+    {
+        struct expr *e = parse_sum(ps);
+        if (!e || !accept(ps, ')'))
+            return fail(ps, e, NULL);
+        return e;
+    }
+
+    if (isdigit((unsigned char)*ps->p) || *ps->p == '.')
+    {
+        char *end;
+        double value = strtod(ps->p, &end);
+        if (end == ps->p || end - ps->p >= EXPR_NAME_LEN || isalpha((unsigned char)*end) || *end == '_')
+            return fail(ps, NULL, NULL);
+
+        struct expr *e = node(ps, EXPR_NUM, NULL, NULL);
+        if (e)
+        {
+            memcpy(e->text, ps->p, end - ps->p);
+            /* no point and no exponent, 010 is octal then */
+            bool hex = e->text[0] == '0' && (e->text[1] == 'x' || e->text[1] == 'X');
+            e->integer = !strpbrk(e->text, hex ? ".pP" : ".eE");
+            e->value = e->integer ? (double)strtoull(e->text, NULL, 0) : value;
+        }
+        ps->p = end;
+        return e;
+    }
+
+    if (isalpha((unsigned char)*ps->p) || *ps->p == '_')
+    {
+        char name[EXPR_NAME_LEN];
+        size_t len = 0;
+        while (isalnum((unsigned char)*ps->p) || *ps->p == '_')
+        {
+            if (len + 1 >= sizeof(name))
+                return fail(ps, NULL, NULL);
+            name[len++] = *ps->p++;
+        }
+        name[len] = '\0';
+
+        if (accept(ps, '('))
+            return parse_call(ps, name);
+        if (!strcmp(name, "x"))
+            return node(ps, EXPR_X, NULL, NULL);
+        if (!strcmp(name, "z"))
+            return node(ps, EXPR_Z, NULL, NULL);
+        if (!strcmp(name, "i"))
+            return node(ps, EXPR_I, NULL, NULL);
+        if (!strcmp(name, "t"))
+            return node(ps, EXPR_T, NULL, NULL);
+    }
+
+    return fail(ps, NULL, NULL);
+}
+
+static struct expr *parse_unary(struct parser *ps)
+{
+    if (accept(ps, '+'))
+        return parse_unary(ps);
+    if (accept(ps, '-'))
+    {
+        struct expr *a = parse_unary(ps);
+        if (!a)
+            return NULL;
+        return node(ps, EXPR_NEG, a, NULL);
+    }
+    return parse_primary(ps);
+}
+
+static struct expr *parse_product(struct parser *ps)
+{
+    struct expr *a = parse_unary(ps);
+    while (a)
+    {
+        enum expr_kind kind;
+        if (accept(ps, '*'))
+            kind = EXPR_MUL;
+        else if (accept(ps, '/'))
+            kind = EXPR_DIV;
+        else
+            break;
+
+        struct expr *b = parse_unary(ps);
+        if (!b)
+            return fail(ps, a, NULL);
+        a = node(ps, kind, a, b);
+    }
+    return a;
+}
+
+static struct expr *parse_sum(struct parser *ps)
+{
+    struct expr *a = parse_product(ps);
+    while (a)
+    {
+        enum expr_kind kind;
+        if (accept(ps, '+'))
+            kind = EXPR_ADD;
+        else if (accept(ps, '-'))
+            kind = EXPR_SUB;
+        else
+            break;
+
+        struct expr *b = parse_product(ps);
+        if (!b)
+            return fail(ps, a, NULL);
+        a = node(ps, kind, a, b);
+    }
+    return a;
+}
+
+struct expr *expr_parse(const char *src)
+{
+    struct parser ps = {src, true};
+    struct expr *e = parse_sum(&ps);
+
+    skip_space(&ps);
+    if (!ps.ok || *ps.p != '\0')
+    {
+        expr_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+void expr_free(struct expr *e)
+{
+    if (!e)
+        return;
+    expr_free(e->args[0]);
+    expr_free(e->args[1]);
+    free(e);
+}
+
+/* appends to out at *len like snprintf, false once it doesn't fit */
+static bool append(char *out, size_t size, size_t *len, const char *fmt, const char *arg)
+{
+    int n = snprintf(out + *len, size - *len, fmt, arg);
+    if (n < 0 || (size_t)n >= size - *len)
+        return false;
+    *len += n;
+    return true;
+}
+
+static bool format_integer(const struct expr *e, char *out, size_t size, size_t *len)
+{
+    static const char *ops[] = {
+        [EXPR_ADD] = " + ",
+        [EXPR_SUB] = " - ",
+        [EXPR_MUL] = " * ",
+        [EXPR_DIV] = " / ",
+    };
+
+    if (!e->integer)
+        return false;
+    if (e->kind == EXPR_NUM)
+        return append(out, size, len, "%s", e->text);
+    if (e->kind == EXPR_NEG)
+        return append(out, size, len, "%s", "(-") && format_integer(e->args[0], out, size, len) &&
+               append(out, size, len, "%s", ")");
+    return append(out, size, len, "%s", "(") && format_integer(e->args[0], out, size, len) &&
+           append(out, size, len, "%s", ops[e->kind]) && format_integer(e->args[1], out, size, len) &&
+           append(out, size, len, "%s", ")");
+}
+
+bool expr_format_integer(const struct expr *e, char *out, size_t size)
+{
+    size_t len = 0;
+    return size > 0 && format_integer(e, out, size, &len);
+}
+
+bool expr_mentions(const char *src, const char *name)
+{
+    size_t len = strlen(name);
+    const char *p = src;
+
+    while (*p)
+    {
+        if (!isalpha((unsigned char)*p) && *p != '_')
+        {
+            /* skip numbers whole, 1e5 is no identifier e */
+            if (isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1])))
+            {
+                while (isalnum((unsigned char)*p) || *p == '.' || *p == '_' ||
+                       ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E')))
+                    ++p;
+            }
+            else
+                ++p;
+            continue;
+        }
+
+        const char *start = p;
+        while (isalnum((unsigned char)*p) || *p == '_')
+            ++p;
+        if ((size_t)(p - start) == len && !strncmp(start, name, len))
+            return true;
+    }
+    return false;
+}
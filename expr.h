@@ -0,0 +1,55 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define EXPR_NAME_LEN 32
+
+/*
+ * syntax tree for the subset of C expressions the code generators
+ * understand: numbers, x, unary minus, + - * /, parentheses and calls to
+ * the math functions the jit templates declare. complex expressions use z
+ * and the imaginary unit i instead of x. t is the animation time.
+ */
+
+enum expr_kind
+{
+    EXPR_NUM,
+    EXPR_X,
+    EXPR_Z,
+    EXPR_I,
+    EXPR_T,
+    EXPR_NEG,
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_CALL,
+};
+
+struct expr
+{
+    enum expr_kind kind;
+    double value;               /* EXPR_NUM */
+    char text[EXPR_NAME_LEN];   /* EXPR_NUM literal as typed, EXPR_CALL function name */
+    bool integer;               /* int in C: an integer literal or + - * / of such, so 1/2 is 0 */
+    int argc;
+    struct expr *args[2];
+};
+
+/* NULL when src is outside the subset */
+struct expr *expr_parse(const char *src);
+void expr_free(struct expr *e);
+
+/*
+ * writes an integer subtree back as C, fully parenthesized, so generated
+ * code can leave its arithmetic to the compiler like the plain function
+ * does. false when e is no integer subtree or out is too small.
+ */
+bool expr_format_integer(const struct expr *e, char *out, size_t size);
+
+/* whether src uses the identifier name anywhere, also for C outside the subset */
+bool expr_mentions(const char *src, const char *name);
+
+#endif /* EXPR_H */
@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include <libtcc.h>
+
+#include "jit.h"
+#include "autodiff.h"
+#include "ddgen.h"
+#include "dd.h"
+#include "cxgen.h"
+#include "cx.h"
+#include "expr.h"
+
+#define SOURCE_SIZE 16384
+#define ERROR_SIZE 256
+
+/* host functions compiled code may call, bound with tcc_add_symbol */
+struct symbol
+{
+    const char *name;
+    const void *fn;
+};
+
+struct symbol_table
+{
+    const struct symbol *symbols;
+    size_t count;
+};
+
+#define TABLE(t) {t, sizeof(t) / sizeof(t[0])}
+
+bool jit_warm_start = true;
+
+/*
+ * the math section of tcclib.h, which used to be included and preprocessed
+ * on every compile. the functions are bound to the host's copies below.
+ */
+static const char *graph_func_template =
+    "double sin(double);double cos(double);double tan(double);"
+    "double sinh(double);double cosh(double);double tanh(double);"
+    "double asin(double);double acos(double);double atan(double);double atan2(double, double);"
+    "double exp(double);double log(double);double log10(double);double pow(double, double);"
+    "double sqrt(double);double ceil(double);double floor(double);"
+    "double graph_func(const double x, const double t){"
+    "return %s;"
+    "}"
+    "double graph_func_d(const double x, const double t, double *dx){"
+    "%s"
+    "}"
+    "void graph_func_batch(const double *xs, double *ys, int n, const double t){"
+    "for (int i = 0; i < n; ++i){const double x = xs[i]; ys[i] = %s;}"
+    "}"
+    "%s";
+
+/* deep zoom variant, the dd_* functions are the host's, bound with tcc_add_symbol */
+static const char *graph_func_dd_template =
+    "typedef struct { double hi, lo; } dd;"
+    "void dd_neg(dd *r, const dd *a);"
+    "void dd_add(dd *r, const dd *a, const dd *b);void dd_sub(dd *r, const dd *a, const dd *b);"
+    "void dd_mul(dd *r, const dd *a, const dd *b);void dd_div(dd *r, const dd *a, const dd *b);"
+    "void dd_sqrt(dd *r, const dd *a);void dd_exp(dd *r, const dd *a);void dd_log(dd *r, const dd *a);"
+    "void dd_log10(dd *r, const dd *a);void dd_pow(dd *r, const dd *a, const dd *b);"
+    "void dd_sin(dd *r, const dd *a);void dd_cos(dd *r, const dd *a);void dd_tan(dd *r, const dd *a);"
+    "void dd_sinh(dd *r, const dd *a);void dd_cosh(dd *r, const dd *a);void dd_tanh(dd *r, const dd *a);"
+    "void dd_asin(dd *r, const dd *a);void dd_acos(dd *r, const dd *a);void dd_atan(dd *r, const dd *a);"
+    "void dd_atan2(dd *r, const dd *y, const dd *x);"
+    "void dd_floor(dd *r, const dd *a);void dd_ceil(dd *r, const dd *a);"
+    "void graph_func_dd(const dd *x, dd *y, const double t){"
+    "%s"
+    "}";
+
+static const struct symbol math_symbols[] = {
+    {"sin", sin}, {"cos", cos}, {"tan", tan},
+    {"sinh", sinh}, {"cosh", cosh}, {"tanh", tanh},
+    {"asin", asin}, {"acos", acos}, {"atan", atan}, {"atan2", atan2},
+    {"exp", exp}, {"log", log}, {"log10", log10}, {"pow", pow},
+    {"sqrt", sqrt}, {"ceil", ceil}, {"floor", floor},
+};
+
+static const struct symbol dd_symbols[] = {
+    {"dd_neg", dd_neg}, {"dd_add", dd_add}, {"dd_sub", dd_sub},
+    {"dd_mul", dd_mul}, {"dd_div", dd_div}, {"dd_sqrt", dd_sqrt},
+    {"dd_exp", dd_exp}, {"dd_log", dd_log}, {"dd_log10", dd_log10},
+    {"dd_pow", dd_pow}, {"dd_sin", dd_sin}, {"dd_cos", dd_cos},
+    {"dd_tan", dd_tan}, {"dd_sinh", dd_sinh}, {"dd_cosh", dd_cosh},
+    {"dd_tanh", dd_tanh}, {"dd_asin", dd_asin}, {"dd_acos", dd_acos},
+    {"dd_atan", dd_atan}, {"dd_atan2", dd_atan2}, {"dd_floor", dd_floor},
+    {"dd_ceil", dd_ceil},
+};
+
+/* domain coloring variant, one row of pixels per call */
+static const char *graph_func_c_template =
+    "typedef struct { double re, im; } cx;"
+    "void cx_div(cx *r, const cx *a, const cx *b);"
+    "void cx_sqrt(cx *r, const cx *a);void cx_exp(cx *r, const cx *a);void cx_log(cx *r, const cx *a);"
+    "void cx_log10(cx *r, const cx *a);void cx_pow(cx *r, const cx *a, const cx *b);"
+    "void cx_sin(cx *r, const cx *a);void cx_cos(cx *r, const cx *a);void cx_tan(cx *r, const cx *a);"
+    "void cx_sinh(cx *r, const cx *a);void cx_cosh(cx *r, const cx *a);void cx_tanh(cx *r, const cx *a);"
+    "void cx_asin(cx *r, const cx *a);void cx_acos(cx *r, const cx *a);void cx_atan(cx *r, const cx *a);"
+    "void graph_func_c(double re, double im, double step, int n, const double t, double *out){"
+    "for (int k = 0; k < n; ++k){"
+    "cx zk = {re + k * step, im};const cx *z = &zk;cx *w = (cx *)out + k;"
+    "%s"
+    "}}";
+
+static const struct symbol cx_symbols[] = {
+    {"cx_div", cx_div}, {"cx_sqrt", cx_sqrt}, {"cx_exp", cx_exp},
+    {"cx_log", cx_log}, {"cx_log10", cx_log10}, {"cx_pow", cx_pow},
+    {"cx_sin", cx_sin}, {"cx_cos", cx_cos}, {"cx_tan", cx_tan},
+    {"cx_sinh", cx_sinh}, {"cx_cosh", cx_cosh}, {"cx_tanh", cx_tanh},
+    {"cx_asin", cx_asin}, {"cx_acos", cx_acos}, {"cx_atan", cx_atan},
+};
+
+/*
+ * single precision variant, math functions are routed to their float
+ * versions and floating literals get an f suffix so nothing is promoted.
+ * compiled on its own so a failure here never costs the double path.
+ */
+static const char *graph_func_f_template =
+    "float sinf(float);float cosf(float);float tanf(float);"
+    "float sinhf(float);float coshf(float);float tanhf(float);"
+    "float asinf(float);float acosf(float);float atanf(float);float atan2f(float, float);"
+    "float expf(float);float logf(float);float log10f(float);float powf(float, float);"
+    "float sqrtf(float);float ceilf(float);float floorf(float);\n"
+    "#define sin(a) sinf(a)\n#define cos(a) cosf(a)\n#define tan(a) tanf(a)\n"
+    "#define sinh(a) sinhf(a)\n#define cosh(a) coshf(a)\n#define tanh(a) tanhf(a)\n"
+    "#define asin(a) asinf(a)\n#define acos(a) acosf(a)\n#define atan(a) atanf(a)\n"
+    "#define atan2(a, b) atan2f(a, b)\n#define exp(a) expf(a)\n#define log(a) logf(a)\n"
+    "#define log10(a) log10f(a)\n#define pow(a, b) powf(a, b)\n#define sqrt(a) sqrtf(a)\n"
+    "#define ceil(a) ceilf(a)\n#define floor(a) floorf(a)\n"
+    "void graph_func_batch_f(const float *xs, float *ys, int n, const float t){"
+    "for (int i = 0; i < n; ++i){const float x = xs[i]; ys[i] = %s;}"
+    "}";
+
+static const struct symbol float_symbols[] = {
+    {"sinf", sinf}, {"cosf", cosf}, {"tanf", tanf},
+    {"sinhf", sinhf}, {"coshf", coshf}, {"tanhf", tanhf},
+    {"asinf", asinf}, {"acosf", acosf}, {"atanf", atanf}, {"atan2f", atan2f},
+    {"expf", expf}, {"logf", logf}, {"log10f", log10f}, {"powf", powf},
+    {"sqrtf", sqrtf}, {"ceilf", ceilf}, {"floorf", floorf},
+};
+
+/* tcc emits calls to these for struct copies and initializers */
+static const struct symbol runtime_symbols[] = {
+    {"memmove", memmove}, {"memcpy", memcpy}, {"memset", memset},
+};
+
+/* used when the expression is outside what autodiff understands */
+static const char *numeric_derivative =
+    "double h = 1e-6 * (1.0 + (x < 0 ? -x : x));"
+    "*dx = (graph_func(x + h, t) - graph_func(x - h, t)) / (2.0 * h);"
+    "return graph_func(x, t);";
+
+/*
+ * what the templates define. the expression is pasted in as C, so one
+ * naming these would recurse until the stack runs out and take the
+ * whole process down with it.
+ */
+static const char *entry_points[] = {
+    "graph_func", "graph_func_d", "graph_func_batch", "graph_func_batch_f", "graph_func_dd",
+};
+
+static bool calls_entry_point(const char *expr)
+{
+    for (size_t i = 0; i < sizeof(entry_points) / sizeof(entry_points[0]); ++i)
+    {
+        if (expr_mentions(expr, entry_points[i]))
+            return true;
+    }
+    return false;
+}
+
+/* the tcc states behind one set of jit_funcs */
+struct jit_module
+{
+    TCCState *state;
+    TCCState *float_state;
+    int refs;
+};
+
+/* what jit_compile and jit_compile_complex last installed */
+static struct jit_module *current = NULL;
+static struct jit_module *current_complex = NULL;
+
+/* copies expr, giving floating literals without a suffix an f suffix */
+static bool float_literals(const char *expr, char *out, size_t size)
+{
+    size_t len = 0;
+    const char *p = expr;
+
+    while (*p)
+    {
+        bool starts_number = isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]));
+        bool in_word = p > expr && (isalnum((unsigned char)p[-1]) || p[-1] == '_');
+
+        if (!starts_number || in_word)
+        {
+            if (len + 1 >= size)
+                return false;
+            out[len++] = *p++;
+            continue;
+        }
+
+        const char *start = p;
+        bool floating = false, suffixed = false;
+        while (isalnum((unsigned char)*p) || *p == '.' || *p == '_' ||
+               ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E')))
+        {
+            if (*p == '.' || *p == 'e' || *p == 'E')
+                floating = true;
+            if (*p == 'f' || *p == 'F' || *p == 'l' || *p == 'L' || *p == 'x' || *p == 'X')
+                suffixed = true;
+            ++p;
+        }
+
+        size_t n = p - start;
+        if (len + n + 2 >= size)
+            return false;
+        memcpy(out + len, start, n);
+        len += n;
+        if (floating && !suffixed)
+            out[len++] = 'f';
+    }
+    out[len] = '\0';
+    return true;
+}
+
+/* keeps the first error tcc reports in opaque, which holds ERROR_SIZE chars */
+static void keep_error(void *opaque, const char *msg)
+{
+    char *error = opaque;
+    if (!error[0] && !strstr(msg, "warning:"))
+        snprintf(error, ERROR_SIZE, "%s", msg);
+}
+
+static void add_symbols(TCCState *s, const struct symbol_table *table)
+{
+    for (size_t i = 0; i < table->count; ++i)
+        tcc_add_symbol(s, table->symbols[i].name, table->symbols[i].fn);
+}
+
+/*
+ * compiles source into memory with the tables bound, NULL on failure.
+ *
+ * the warm path sets up no include paths and links no runtime libraries,
+ * which is most of what a compile costs, since everything the templates
+ * call is bound by hand. code that needs more, e.g. a printf typed into
+ * the expression or a helper only libtcc1 has, gets a second try with a
+ * regular state. that is only when the warm one failed to link or to
+ * find an include file, a syntax error fails the same way twice. errors
+ * are printed unless quiet is set.
+ */
+static TCCState *compile_source(const char *source, const struct symbol_table *tables, int table_count,
+                                bool quiet)
+{
+    const struct symbol_table runtime = TABLE(runtime_symbols);
+
+    char error[ERROR_SIZE];
+
+    for (int warm = jit_warm_start; warm >= 0; --warm)
+    {
+        TCCState *s = tcc_new();
+        if (!s)
+            return NULL;
+        error[0] = '\0';
+        if (warm || quiet)
+            tcc_set_error_func(s, error, keep_error);
+        if (warm)
+            tcc_set_options(s, "-nostdinc -nostdlib");
+        tcc_set_output_type(s, TCC_OUTPUT_MEMORY);
+
+        add_symbols(s, &runtime);
+        for (int i = 0; i < table_count; ++i)
+            add_symbols(s, &tables[i]);
+
+        bool compiled = tcc_compile_string(s, source) >= 0;
+        if (compiled && tcc_relocate(s, TCC_RELOCATE_AUTO) >= 0)
+            return s;
+        tcc_delete(s);
+
+        if (warm && !compiled && !strstr(error, "include file"))
+        {
+            if (!quiet)
+                printf("%s\n", error);
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/* the float batch entry point, or NULL where it can't be built */
+static TCCState *compile_float(const char *expr, char *source, struct jit_funcs *funcs)
+{
+    char literals[1024];
+    funcs->graph_func_batch_f = NULL;
+
+    if (!float_literals(expr, literals, sizeof(literals)))
+        return NULL;
+
+    int len = snprintf(source, SOURCE_SIZE, graph_func_f_template, literals);
+    if (len < 0 || len >= SOURCE_SIZE)
+        return NULL;
+
+    const struct symbol_table tables[] = {TABLE(float_symbols)};
+    TCCState *s = compile_source(source, tables, 1, true);
+    if (!s)
+        return NULL;
+
+    funcs->graph_func_batch_f = tcc_get_symbol(s, "graph_func_batch_f");
+    return s;
+}
+
+struct jit_module *jit_build(const char *expr, struct jit_funcs *out)
+{
+    if (calls_entry_point(expr))
+    {
+        printf("An expression can't call itself.\n");
+        return NULL;
+    }
+
+    char *derivative = malloc(SOURCE_SIZE);
+    char *deep = malloc(SOURCE_SIZE);
+    char *source = malloc(SOURCE_SIZE);
+    struct jit_module *module = NULL;
+    if (!derivative || !deep || !source)
+    {
+        printf("Out of memory compiling %s\n", expr);
+        goto done;
+    }
+
+    if (!ad_emit(expr, derivative, SOURCE_SIZE))
+        snprintf(derivative, SOURCE_SIZE, "%s", numeric_derivative);
+
+    /* reuses source as scratch for the body */
+    bool has_dd = dd_emit(expr, source, SOURCE_SIZE);
+    int len = 0;
+    if (has_dd)
+        len = snprintf(deep, SOURCE_SIZE, graph_func_dd_template, source);
+    if (!has_dd || len < 0 || len >= SOURCE_SIZE)
+    {
+        has_dd = false;
+        deep[0] = '\0';
+    }
+
+    len = snprintf(source, SOURCE_SIZE, graph_func_template, expr, derivative, expr, deep);
+    if (len < 0 || len >= SOURCE_SIZE)
+    {
+        printf("Expression too long.\n");
+        goto done;
+    }
+
+    const struct symbol_table tables[] = {TABLE(math_symbols), TABLE(dd_symbols)};
+    TCCState *s = compile_source(source, tables, 2, false);
+    if (!s)
+    {
+        printf("Compilation error.\n");
+        goto done;
+    }
+
+    struct jit_funcs funcs;
+    funcs.graph_func = tcc_get_symbol(s, "graph_func");
+    funcs.graph_func_d = tcc_get_symbol(s, "graph_func_d");
+    funcs.graph_func_batch = tcc_get_symbol(s, "graph_func_batch");
+    funcs.graph_func_dd = has_dd ? tcc_get_symbol(s, "graph_func_dd") : NULL;
+    funcs.time = 0;
+    if (!funcs.graph_func || !funcs.graph_func_d || !funcs.graph_func_batch)
+    {
+        printf("Compilation error.\n");
+        tcc_delete(s);
+        goto done;
+    }
+
+    module = malloc(sizeof(*module));
+    if (!module)
+    {
+        printf("Out of memory compiling %s\n", expr);
+        tcc_delete(s);
+        goto done;
+    }
+    module->state = s;
+    module->refs = 1;
+    module->float_state = compile_float(expr, source, &funcs);
+    *out = funcs;
+
+done:
+    free(source);
+    free(deep);
+    free(derivative);
+    return module;
+}
+
+void jit_release(struct jit_module *module)
+{
+    if (!module || --module->refs > 0)
+        return;
+    tcc_delete(module->state);
+    if (module->float_state)
+        tcc_delete(module->float_state);
+    free(module);
+}
+
+bool jit_compile(const char *expr, struct jit_funcs *out)
+{
+    struct jit_module *module = jit_build(expr, out);
+    if (!module)
+        return false;
+
+    jit_release(current);
+    current = module;
+    return true;
+}
+
+struct jit_module *jit_build_complex(const char *expr, jit_complex_row *out)
+{
+    char *body = malloc(SOURCE_SIZE);
+    char *source = malloc(SOURCE_SIZE);
+    struct jit_module *module = NULL;
+    if (!body || !source)
+    {
+        printf("Out of memory compiling %s\n", expr);
+        goto done;
+    }
+
+    if (!cx_emit(expr, body, SOURCE_SIZE))
+    {
+        printf("Not a complex expression in z.\n");
+        goto done;
+    }
+
+    int len = snprintf(source, SOURCE_SIZE, graph_func_c_template, body);
+    if (len < 0 || len >= SOURCE_SIZE)
+    {
+        printf("Expression too long.\n");
+        goto done;
+    }
+
+    const struct symbol_table tables[] = {TABLE(cx_symbols)};
+    TCCState *s = compile_source(source, tables, 1, false);
+    jit_complex_row row = s ? tcc_get_symbol(s, "graph_func_c") : NULL;
+    if (!row)
+    {
+        printf("Compilation error.\n");
+        if (s)
+            tcc_delete(s);
+        goto done;
+    }
+
+    module = malloc(sizeof(*module));
+    if (!module)
+    {
+        printf("Out of memory compiling %s\n", expr);
+        tcc_delete(s);
+        goto done;
+    }
+    module->state = s;
+    module->float_state = NULL;
+    module->refs = 1;
+    *out = row;
+
+done:
+    free(source);
+    free(body);
+    return module;
+}
+
+bool jit_compile_complex(const char *expr, jit_complex_row *out)
+{
+    struct jit_module *module = jit_build_complex(expr, out);
+    if (!module)
+        return false;
+
+    jit_release(current_complex);
+    current_complex = module;
+    return true;
+}
+
+struct jit_module *jit_retain(bool complex)
+{
+    struct jit_module *module = complex ? current_complex : current;
+    if (module)
+        ++module->refs;
+    return module;
+}
+
+void jit_free(void)
+{
+    jit_release(current);
+    jit_release(current_complex);
+    current = NULL;
+    current_complex = NULL;
+}
@@ -0,0 +1,71 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+
+#include "dd.h"
+
+/* entry points compiled from one user expression, every one takes t */
+struct jit_funcs
+{
+    double (*graph_func)(const double x, const double t);
+    /* returns f(x) and stores f'(x) in *dx */
+    double (*graph_func_d)(const double x, const double t, double *dx);
+    /* ys[i] = f(xs[i]) with the expression inlined into the loop */
+    void (*graph_func_batch)(const double *xs, double *ys, int n, const double t);
+    /* single precision batch, NULL when the float variant fails to build */
+    void (*graph_func_batch_f)(const float *xs, float *ys, int n, const float t);
+    /* double-double evaluation for deep zoom, NULL outside the expr.h subset */
+    void (*graph_func_dd)(const dd *x, dd *y, const double t);
+    /* what callers handing these around pass as t, 0 after a build */
+    double time;
+};
+
+/*
+ * compile against a bare tcc state with every callee bound up front,
+ * falling back to a regular one where that can't find a header or link,
+ * but not after a syntax error. on by default, turning it off is only
+ * useful to measure the difference.
+ */
+extern bool jit_warm_start;
+
+/* the compiled code behind one jit_funcs, valid until every reference is released */
+struct jit_module;
+
+/*
+ * compiles expr with tcc and fills in out, NULL on failure. modules are
+ * independent so any number can be alive at once, but tcc itself is not
+ * reentrant: only build from one thread at a time.
+ */
+struct jit_module *jit_build(const char *expr, struct jit_funcs *out);
+/* drops a reference, the last one frees the code */
+void jit_release(struct jit_module *module);
+
+/*
+ * compiles expr with tcc. on success the previous compilation is released
+ * and out is filled in, on failure out and the previous code are left alone.
+ */
+bool jit_compile(const char *expr, struct jit_funcs *out);
+
+/*
+ * complex f(z) over one row of pixels: out[2k] and out[2k + 1] get the real
+ * and imaginary part of f(re + k * step + i * im) for k in [0, n) at time t.
+ */
+typedef void (*jit_complex_row)(double re, double im, double step, int n, double t, double *out);
+
+/* like jit_build and jit_compile, for expressions in z */
+struct jit_module *jit_build_complex(const char *expr, jit_complex_row *out);
+bool jit_compile_complex(const char *expr, jit_complex_row *out);
+
+/* releases what jit_compile and jit_compile_complex installed */
+void jit_free(void);
+
+/*
+ * another reference to what jit_compile (jit_compile_complex if complex)
+ * installed, NULL if that is nothing. for code a stuck thread may still
+ * run: it stays alive after being replaced until this is released too.
+ * only take and release references on the thread that compiles.
+ */
+struct jit_module *jit_retain(bool complex);
+
+#endif /* JIT_H */
@@ -4,17 +4,43 @@
 #include <math.h>
 #include <unistd.h>
 
-#include <libtcc.h>
 #include <SDL2/SDL.h>
 
+#include "jit.h"
+#include "pool.h"
+#include "analysis.h"
+#include "axes.h"
+#include "record.h"
+#include "eval.h"
+#include "dd.h"
+#include "plot.h"
+#include "batch.h"
+#include "domain.h"
+#include "watchdog.h"
+#include "expr.h"
+#include "export.h"
+
 #define S_WIDTH 1200
 #define S_HEIGHT 900
 #define FS_WIDTH 1200.0
 #define FS_HEIGHT 900.0
 
+/* frames taking longer are cancelled and the function marked too slow */
+#define FRAME_BUDGET_MS 2000
+/* same for vector exports, which take far more samples than a frame */
+#define EXPORT_BUDGET_MS 10000
+/* used when the driver doesn't report the display refresh rate */
+#define DEFAULT_REFRESH 60
+/* t advances this much per replayed frame, so replays animate the same everywhere */
+#define REPLAY_DT (1.0 / 60)
+
 #define STEP_DOWN 0.875
 #define STEP_UP 1.125
 
+/* grid density for root and extremum bracketing */
+#define MARKER_SAMPLES_PER_PIXEL 4
+#define MARKER_SIZE 3
+
 int clamp(int x, int min, int max)
 {
     if (x < min)
@@ -24,116 +50,912 @@ int clamp(int x, int min, int max)
     return x;
 }
 
-double (*graph_func)(const double x);
+struct jit_funcs funcs;
 
 /* default */
-double f(const double x)
+double f(const double x, const double t)
 {
+    (void)t;
     return x;
 }
+double f_d(const double x, const double t, double *dx)
+{
+    (void)t;
+    *dx = 1;
+    return x;
+}
+void f_batch(const double *xs, double *ys, int n, const double t)
+{
+    (void)t;
+    for (int i = 0; i < n; ++i)
+        ys[i] = xs[i];
+}
+void f_batch_f(const float *xs, float *ys, int n, const float t)
+{
+    (void)t;
+    for (int i = 0; i < n; ++i)
+        ys[i] = xs[i];
+}
+void f_complex(double re, double im, double step, int n, double t, double *out)
+{
+    (void)t;
+    for (int k = 0; k < n; ++k)
+    {
+        out[2 * k] = re + k * step;
+        out[2 * k + 1] = im;
+    }
+}
+
+/* domain coloring of f(z) instead of the graph of f(x) */
+bool complex_mode = false;
+jit_complex_row complex_func = &f_complex;
+
+/* the function uses t, so every frame is different */
+bool funcs_animated = false;
+bool complex_animated = false;
+
+bool show_markers = true;
 
-const char *graph_func_template =
-    "#include <tcclib.h>"
-    "double graph_func(const double x){"
-    "return %s;"
-    "}";
+/* draw the graph from a chebyshev fit instead of evaluating f for every sample */
+bool accelerate = false;
 
 double scale = 1;
 double x_offset = 0;
 double y_offset = 0;
+/* low order parts, x_offset + x_offset_lo is the offset as a double-double */
+double x_offset_lo = 0;
+double y_offset_lo = 0;
+
+/* pans by (dx, dy) world units without dropping the low order bits */
+static void shift_view(double dx, double dy)
+{
+    dd x = dd_sum_d((dd){x_offset, x_offset_lo}, dx);
+    dd y = dd_sum_d((dd){y_offset, y_offset_lo}, dy);
+    x_offset = x.hi;
+    x_offset_lo = x.lo;
+    y_offset = y.hi;
+    y_offset_lo = y.lo;
+}
+
+/* the current view in the form plot_render takes */
+static struct plot_view current_view(void)
+{
+    struct plot_view view;
+    view.scale = scale;
+    view.width = S_WIDTH;
+    view.height = S_HEIGHT;
+    /* the world point under the middle of the window, kept in double-double */
+    view.center_x = dd_sum_d((dd){x_offset, x_offset_lo}, S_WIDTH / 2 / scale - S_WIDTH / 2);
+    view.center_y = dd_sum_d((dd){-y_offset, -y_offset_lo}, S_HEIGHT / 2 - S_HEIGHT / 2 / scale);
+    return view;
+}
+
+static void draw_marker(unsigned int *pixels, const struct plot_view *view, const struct marker *m)
+{
+    /* same mapping plot_render uses for the curve */
+    double sx = S_WIDTH / 2 + (m->x - dd_to_double(view->center_x)) * view->scale;
+    double sy = S_HEIGHT / 2 - (m->y - dd_to_double(view->center_y)) * view->scale;
+    if (!(sx > -MARKER_SIZE && sx < S_WIDTH + MARKER_SIZE && sy > -MARKER_SIZE && sy < S_HEIGHT + MARKER_SIZE))
+        return;
+
+    unsigned int color;
+    switch (m->kind)
+    {
+    case MARKER_ROOT:
+        color = 0xff5050ff;
+        break;
+    case MARKER_MIN:
+        color = 0x50ff50ff;
+        break;
+    default:
+        color = 0x5080ffff;
+        break;
+    }
+
+    int cx = sx, cy = sy;
+    for (int y = cy - MARKER_SIZE; y <= cy + MARKER_SIZE; ++y)
+    {
+        for (int x = cx - MARKER_SIZE; x <= cx + MARKER_SIZE; ++x)
+        {
+            if (x < 0 || x >= S_WIDTH || y < 0 || y >= S_HEIGHT)
+                continue;
+            pixels[y * S_WIDTH + x] = color;
+        }
+    }
+}
 
-static inline int to_screen_x(double x)
+/* everything a frame reads, copied so the render thread never sees an event half applied */
+struct frame_job
 {
-    return (x - x_offset) * scale;
+    struct plot_view view;
+    struct jit_funcs funcs;
+    jit_complex_row complex_func;
+    bool complex_mode;
+    bool show_markers;
+    bool accelerate;
+    bool animated;
+    double time;             /* t for this frame */
+    unsigned int expression; /* bumped by every new expression */
+    char export_path[256];   /* write the graph there instead of drawing it */
+};
+
+unsigned int expression_count = 0;
+
+static struct frame_job snapshot(double time)
+{
+    struct frame_job job;
+    job.view = current_view();
+    job.funcs = funcs;
+    job.complex_func = complex_func;
+    job.complex_mode = complex_mode;
+    job.show_markers = show_markers;
+    job.accelerate = accelerate;
+    job.animated = complex_mode ? complex_animated : funcs_animated;
+    job.time = time;
+    job.funcs.time = time;
+    job.expression = expression_count;
+    job.export_path[0] = '\0';
+    return job;
 }
-static inline double to_world_x(float x)
+
+/*
+ * what a render thread keeps from frame to frame. every render thread has
+ * its own, so one left behind by the watchdog never shares it with the
+ * thread drawing now. zero initialize.
+ */
+struct render_state
+{
+    struct axes_cache axes;
+    struct cheb_cache cheb;
+    struct analysis_cache analysis;
+    struct domain_cache domain;
+    unsigned int seen_expression;
+    double seen_time;
+
+    /* whether float was timed faster than double for the expression */
+    bool float_timed;
+    bool float_faster;
+
+    /* precision of the last graph drawn, replays report frame times by it */
+    enum eval_precision precision;
+};
+
+static void render_state_free(struct render_state *state)
 {
-    return (x / scale) + x_offset - (S_WIDTH / 2);
+    free(state->cheb.segments);
+    analysis_free(&state->analysis);
+    domain_free(&state->domain);
 }
-static inline int to_screen_y(double y)
+
+void render_graph(const struct frame_job *job, struct render_state *state, unsigned int *pixels)
 {
-    return (y - y_offset) * scale;
+    const struct plot_view *view = &job->view;
+
+    if (job->show_markers)
+    {
+        double half_w = S_WIDTH / 2 / view->scale;
+        double cx = dd_to_double(view->center_x);
+        analysis_update(&state->analysis, &job->funcs, cx - half_w, cx + half_w,
+                        1 / (view->scale * MARKER_SAMPLES_PER_PIXEL));
+    }
+
+    /* eval_choose only considers float when it was measured to be faster */
+    struct jit_funcs curve = job->funcs;
+    if (!state->float_timed)
+    {
+        double half_w = S_WIDTH / 2 / view->scale;
+        double cx = dd_to_double(view->center_x);
+        state->float_faster = eval_float_faster(&curve, cx - half_w, cx + half_w);
+        state->float_timed = true;
+    }
+    if (!state->float_faster)
+        curve.graph_func_batch_f = NULL;
+
+    state->precision = plot_render(&curve, view, &state->axes,
+                                   job->accelerate ? &state->cheb : NULL, pixels);
+
+    if (job->show_markers)
+    {
+        const struct marker *markers;
+        int count = analysis_markers(&state->analysis, &markers);
+        for (int i = 0; i < count; ++i)
+            draw_marker(pixels, view, &markers[i]);
+    }
 }
-static inline double to_world_y(float y)
+
+void render_domain(const struct frame_job *job, struct render_state *state, unsigned int *pixels)
 {
-    return (y / scale) + y_offset - (S_WIDTH / 2);
+    const struct plot_view *view = &job->view;
+    domain_render(&state->domain, job->complex_func, job->time, pixels, S_WIDTH, S_HEIGHT,
+                  dd_to_double(view->center_x), dd_to_double(view->center_y), view->scale);
 }
 
-void render_graph(SDL_Surface *surface)
+void render_frame(const struct frame_job *job, struct render_state *state, SDL_Surface *surface)
 {
+    if (job->expression != state->seen_expression || (job->animated && job->time != state->seen_time))
+    {
+        if (job->expression != state->seen_expression)
+            state->float_timed = false;
+        state->seen_expression = job->expression;
+        analysis_reset(&state->analysis);
+        domain_reset(&state->domain);
+        cheb_reset(&state->cheb);
+    }
+    state->seen_time = job->time;
+
+    if (job->export_path[0])
+    {
+        export_vector(&job->funcs, &job->view, job->export_path);
+        return;
+    }
+
     if (SDL_LockSurface(surface) < 0)
     {
-        printf("error in SDL_LockSurface: %s", SDL_GetError());
+        printf("error in SDL_LockSurface: %s\n", SDL_GetError());
         exit(EXIT_FAILURE);
     }
-    memset(surface->pixels, 0, surface->pitch * S_HEIGHT);
 
-    unsigned int *pixels = surface->pixels;
+    if (job->complex_mode)
+        render_domain(job, state, surface->pixels);
+    else
+        render_graph(job, state, surface->pixels);
+
+    SDL_UnlockSurface(surface);
+}
+
+/* a frame for the render thread, drawn into its own canvas with its own caches */
+struct frame
+{
+    struct frame_job job;
+    struct render_state state;
+    SDL_Surface *canvas;
+    SDL_atomic_t done; /* set once render_task returns */
+};
+
+static struct frame *new_frame(void)
+{
+    struct frame *f = calloc(1, sizeof(*f));
+    if (f)
+        f->canvas = SDL_CreateRGBSurfaceWithFormat(0, S_WIDTH, S_HEIGHT, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (!f || !f->canvas)
+    {
+        printf("error in SDL_CreateRGBSurfaceWithFormat: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+    return f;
+}
+
+static void free_frame(struct frame *f)
+{
+    render_state_free(&f->state);
+    SDL_FreeSurface(f->canvas);
+    free(f);
+}
+
+static void render_task(void *ctx)
+{
+    struct frame *f = ctx;
+    render_frame(&f->job, &f->state, f->canvas);
+    SDL_AtomicSet(&f->done, 1);
+}
+
+static void present(SDL_Surface *canvas, SDL_Surface *surface)
+{
+    if (SDL_LockSurface(surface) < 0)
+    {
+        printf("error in SDL_LockSurface: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    /* the canvas is RGBA8888, window surfaces usually XRGB8888 or ARGB8888 */
+    if (SDL_ConvertPixels(S_WIDTH, S_HEIGHT, canvas->format->format, canvas->pixels, canvas->pitch,
+                          surface->format->format, surface->pixels, surface->pitch) < 0)
+        printf("error in SDL_ConvertPixels: %s\n", SDL_GetError());
+
+    SDL_UnlockSurface(surface);
+}
+
+/* handed to the render thread, replaced whenever a stuck thread takes it along */
+static struct frame *next_frame = NULL;
+
+/* set once a frame blows FRAME_BUDGET_MS, cleared by a new function */
+bool too_slow = false;
+
+/* a render thread left behind, with the frame and code it still uses */
+struct stray
+{
+    struct frame *frame;
+    struct jit_module *module;
+    struct stray *next;
+};
+
+static struct stray *strays = NULL;
+
+/* leaves a render thread stuck in compiled code behind, with the code and frame it uses */
+static void abandon_render(void)
+{
+    if (!watchdog_busy())
+        return;
+
+    watchdog_abandon();
+    struct stray *s = malloc(sizeof(*s));
+    if (s)
+    {
+        s->frame = next_frame;
+        s->module = jit_retain(next_frame->job.complex_mode);
+        s->next = strays;
+        strays = s;
+    }
+    /* without a record the frame and code are never freed, which is still safe */
+    next_frame = new_frame();
+}
+
+/* frees what strays were using once their job returned */
+static void reap_strays(void)
+{
+    struct stray **link = &strays;
+    while (*link)
+    {
+        struct stray *s = *link;
+        if (!SDL_AtomicGet(&s->frame->done))
+        {
+            link = &s->next;
+            continue;
+        }
+        *link = s->next;
+        jit_release(s->module);
+        free_frame(s->frame);
+        free(s);
+    }
+}
+
+bool mouse_down = false;
+Sint32 mouse_x = 0, mouse_y = 0;
+
+/* frames since start, the clock replays are driven by */
+unsigned int frame = 0;
+
+void set_expression(const char *expr)
+{
+    /* the old code can't be released while a stuck thread still runs it */
+    abandon_render();
+
+    bool ok = complex_mode ? jit_compile_complex(expr, &complex_func) : jit_compile(expr, &funcs);
+    if (ok)
+    {
+        *(complex_mode ? &complex_animated : &funcs_animated) = expr_mentions(expr, "t");
+        ++expression_count;
+        too_slow = false;
+    }
+}
+
+void prompt_expression(void)
+{
+    char scan_buf[256];
+
+    fflush(stdin);
+    printf(complex_mode ? "f(z) = " : "f(x) = ");
+    if (scanf("%255s", scan_buf) != 1)
+        return;
+
+    record_expression(frame, SDL_GetTicks(), scan_buf);
+    set_expression(scan_buf);
+}
+
+/*
+ * writes the graph as it is on screen to an SVG or PDF file. runs on the
+ * render thread under the watchdog like a frame, so a runaway function
+ * can't hang the window by way of an export either.
+ */
+void prompt_export(void)
+{
+    char scan_buf[256];
+
+    if (!next_frame)
+        return;
+    if (complex_mode)
+    {
+        printf("Only graphs can be exported.\n");
+        return;
+    }
+    if (too_slow || watchdog_busy())
+    {
+        printf("Too slow to export, enter another expression.\n");
+        return;
+    }
+
+    fflush(stdin);
+    printf("export to (.svg or .pdf): ");
+    if (scanf("%255s", scan_buf) != 1)
+        return;
+
+    /* same t as the frame on screen */
+    next_frame->job = snapshot(next_frame->job.time);
+    snprintf(next_frame->job.export_path, sizeof(next_frame->job.export_path), "%s", scan_buf);
+    SDL_AtomicSet(&next_frame->done, 0);
+    if (watchdog_run(render_task, next_frame, EXPORT_BUDGET_MS) == WATCHDOG_STUCK)
+    {
+        too_slow = true;
+        printf("Too slow to export, enter another expression.\n");
+    }
+}
+
+/* returns false once the program should quit */
+bool handle_event(const SDL_Event *e)
+{
+    switch (e->type)
+    {
+    case SDL_QUIT:
+        return false;
+    case SDL_MOUSEBUTTONDOWN:
+        mouse_down = true;
+        break;
+    case SDL_MOUSEBUTTONUP:
+        mouse_down = false;
+        break;
+    case SDL_MOUSEWHEEL:
+        double old_scale = scale;
+
+        if (e->wheel.y > 0)
+            scale *= STEP_UP;
+        else
+            scale *= STEP_DOWN;
+
+        /* the mouse's world x before minus after, without the offset cancelling out */
+        shift_view(mouse_x / old_scale - mouse_x / scale, mouse_y / old_scale - mouse_y / scale);
+        break;
+    case SDL_MOUSEMOTION:
+        mouse_x = e->motion.x;
+        mouse_y = e->motion.y;
+        if (mouse_down)
+        {
+            shift_view(-e->motion.xrel / scale, -e->motion.yrel / scale);
+        }
+        break;
+    case SDL_KEYDOWN:
+        switch (e->key.keysym.scancode)
+        {
+        case SDL_SCANCODE_RETURN:
+            prompt_expression();
+            break;
+        case SDL_SCANCODE_E:
+            prompt_export();
+            break;
+        case SDL_SCANCODE_M:
+            show_markers = !show_markers;
+            break;
+        case SDL_SCANCODE_A:
+            accelerate = !accelerate;
+            printf("Chebyshev acceleration %s\n", accelerate ? "on" : "off");
+            break;
+        case SDL_SCANCODE_C:
+            abandon_render();
+            complex_mode = !complex_mode;
+            too_slow = false;
+            break;
+        default:
+        }
+        break;
+    default:
+    }
+    return true;
+}
+
+/*
+ * frame-paced animation clock. t counts display refresh periods rather
+ * than wall time, and a frame that overruns skips whole periods, which
+ * are reported as dropped. a window surface has no vsync, so the periods
+ * are only timed to the refresh rate, not locked to the display's phase:
+ * pacing approximates the refresh and some tearing is possible.
+ */
+struct frame_clock
+{
+    Uint64 start;
+    Uint64 period;
+    double rate;
+    unsigned long long slot; /* refresh periods since start, the one being drawn */
+    unsigned int dropped;
+};
+
+static void clock_start(struct frame_clock *c, SDL_Window *window)
+{
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(window);
+    c->rate = DEFAULT_REFRESH;
+    if (display >= 0 && SDL_GetCurrentDisplayMode(display, &mode) == 0 && mode.refresh_rate > 0)
+        c->rate = mode.refresh_rate;
+
+    c->start = SDL_GetPerformanceCounter();
+    c->period = SDL_GetPerformanceFrequency() / c->rate;
+    c->slot = 0;
+    c->dropped = 0;
+}
+
+static double clock_time(const struct frame_clock *c)
+{
+    return c->slot / c->rate;
+}
+
+/* sleeps until the next refresh, counting the ones the last frame overran */
+static void clock_wait(struct frame_clock *c, bool animated)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    unsigned long long due = (now - c->start) / c->period + 1;
+    if (due <= c->slot)
+        due = c->slot + 1;
+    if (animated)
+        c->dropped += due - c->slot - 1;
+    c->slot = due;
+
+    /* SDL_Delay counts whole milliseconds and may wake late: sleep to one short, spin the rest */
+    Uint64 target = c->start + due * c->period;
+    now = SDL_GetPerformanceCounter();
+    Uint64 ms = target > now ? (target - now) * 1000 / SDL_GetPerformanceFrequency() : 0;
+    if (ms > 1)
+        SDL_Delay(ms - 1);
+    while (SDL_GetPerformanceCounter() < target)
+        ;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * feeds a recording back frame by frame, timing each frame. frames run on
+ * the watched render thread like live ones, so a runaway expression in the
+ * recording is cut off and its frames skipped until the next expression.
+ */
+int run_replay(const char *path, const char *timings_path)
+{
+    FILE *fp = replay_open(path);
+    if (!fp)
+        return EXIT_FAILURE;
+
+    FILE *csv = NULL;
+    if (timings_path)
+    {
+        csv = fopen(timings_path, "w");
+        if (csv)
+            fprintf(csv, "frame,ms\n");
+        else
+            printf("Can't open %s for writing\n", timings_path);
+    }
+
+    double *timings = NULL;
+    unsigned int capacity = 0, frames = 0, skipped = 0;
+    double freq = SDL_GetPerformanceFrequency();
 
-    /* horizontal graph line */
-    unsigned int set_y = to_screen_y(S_HEIGHT / 2);
-    if (set_y < S_HEIGHT)
+    /* graph frames by the precision they were evaluated in */
+    static const char *precision_names[] = {
+        [EVAL_DOUBLE] = "double",
+        [EVAL_FLOAT] = "float",
+        [EVAL_DD] = "double-double",
+    };
+    unsigned int precision_frames[3] = {0};
+    double precision_ms[3] = {0};
+
+    next_frame = new_frame();
+    struct record_entry entry;
+    bool pending = replay_read(fp, &entry);
+    bool quit = false;
+
+    for (frame = 0; !quit; ++frame)
     {
-        for (int x = 0; x < S_WIDTH; ++x)
+        while (pending && entry.frame <= frame)
         {
-            pixels[set_y * S_WIDTH + x] = 0x737373ff;
+            if (entry.kind == REC_EXPR)
+                set_expression(entry.expr);
+            else if (!handle_event(&entry.event))
+                quit = true;
+            pending = replay_read(fp, &entry);
         }
+        if (!pending)
+            quit = true;
+
+        reap_strays();
+        if (too_slow)
+        {
+            ++skipped;
+            continue;
+        }
+
+        next_frame->job = snapshot(frame * REPLAY_DT);
+        SDL_AtomicSet(&next_frame->done, 0);
+        Uint64 start = SDL_GetPerformanceCounter();
+        enum watchdog_result result = watchdog_run(render_task, next_frame, FRAME_BUDGET_MS);
+        Uint64 end = SDL_GetPerformanceCounter();
+        if (result != WATCHDOG_DONE)
+        {
+            too_slow = true;
+            printf("Too slow to draw at frame %u, skipping to the next expression.\n", frame);
+            ++skipped;
+            continue;
+        }
+
+        if (frames == capacity)
+        {
+            unsigned int grown_capacity = capacity ? capacity * 2 : 1024;
+            double *grown = realloc(timings, grown_capacity * sizeof(*timings));
+            if (!grown)
+            {
+                printf("Out of memory after %u frames, the replay stops there\n", frames);
+                break;
+            }
+            timings = grown;
+            capacity = grown_capacity;
+        }
+        double ms = (end - start) * 1000.0 / freq;
+        timings[frames++] = ms;
+        if (csv)
+            fprintf(csv, "%u,%.4f\n", frame, ms);
+        if (!next_frame->job.complex_mode)
+        {
+            ++precision_frames[next_frame->state.precision];
+            precision_ms[next_frame->state.precision] += ms;
+        }
+    }
+    fclose(fp);
+    if (csv)
+        fclose(csv);
+
+    /* a last frame still stuck is left to itself */
+    abandon_render();
+    reap_strays();
+    free_frame(next_frame);
+    next_frame = NULL;
+
+    if (frames == 0)
+    {
+        printf("replay: no frames drawn, %u skipped\n", skipped);
+        free(timings);
+        return EXIT_FAILURE;
+    }
+
+    double total = 0;
+    for (unsigned int i = 0; i < frames; ++i)
+        total += timings[i];
+    qsort(timings, frames, sizeof(*timings), compare_doubles);
+
+    printf("replay: %u frames, %.2f ms total, mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+           frames, total, total / frames, timings[frames / 2], timings[frames * 95 / 100], timings[frames - 1]);
+    if (skipped)
+        printf("replay: %u frames skipped as too slow\n", skipped);
+    for (int p = 0; p < 3; ++p)
+    {
+        if (precision_frames[p])
+            printf("replay: %u graph frames in %s, mean %.3f ms\n", precision_frames[p],
+                   precision_names[p], precision_ms[p] / precision_frames[p]);
     }
 
-    /* vertical graph line */
-    unsigned int set_x = to_screen_x(S_WIDTH / 2);
-    if (set_x < S_WIDTH)
+    free(timings);
+    return EXIT_SUCCESS;
+}
+
+/* typical input, compiled round after round by run_bench_compile */
+static const char *bench_expressions[] = {
+    "x", "sin(x)", "x*x-2", "sin(x)/x", "exp(-x*x)*cos(10*x)",
+    "pow(x,3)-3*x+1", "tan(x)+sqrt(x)", "log(1+x*x)*atan(x)",
+};
+
+/* times jit_build from source to symbols, with and without the warm start */
+int run_bench_compile(int rounds)
+{
+    int expressions = sizeof(bench_expressions) / sizeof(bench_expressions[0]);
+    int count = rounds * expressions;
+    double *timings = malloc(count * sizeof(*timings));
+    if (!timings)
     {
-        for (int y = 0; y < S_HEIGHT; ++y)
+        printf("Out of memory for the benchmark\n");
+        return EXIT_FAILURE;
+    }
+    double freq = SDL_GetPerformanceFrequency();
+    int status = EXIT_SUCCESS;
+
+    for (int warm = 1; warm >= 0; --warm)
+    {
+        jit_warm_start = warm;
+
+        for (int i = 0; i < count; ++i)
         {
-            pixels[y * S_WIDTH + set_x] = 0x737373ff;
+            struct jit_funcs out;
+            Uint64 start = SDL_GetPerformanceCounter();
+            struct jit_module *module = jit_build(bench_expressions[i % expressions], &out);
+            Uint64 end = SDL_GetPerformanceCounter();
+
+            if (!module)
+                status = EXIT_FAILURE;
+            jit_release(module);
+            timings[i] = (end - start) * 1000.0 / freq;
         }
+
+        double total = 0;
+        for (int i = 0; i < count; ++i)
+            total += timings[i];
+        qsort(timings, count, sizeof(*timings), compare_doubles);
+
+        printf("compile (%s): %d compiles, mean %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms\n",
+               warm ? "warm" : "cold", count, total / count, timings[count / 2],
+               timings[count * 95 / 100], timings[count - 1]);
     }
 
+    jit_warm_start = true;
+    free(timings);
+    return status;
+}
 
-    // double last_y = S_HEIGHT - graph_func(to_world_x(0)) - S_HEIGHT / 2;
+/* samples per pixel run_bench_cheb compares the fit to the function at */
+#define CHEB_CHECKS_PER_PIXEL 200
 
-    for (double x = 0; x < S_WIDTH; x += 0.005)
+/* milliseconds since start, for the benchmarks */
+static double elapsed_ms(Uint64 start)
+{
+    return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+/*
+ * times frames of a fixed view drawn directly and through the chebyshev
+ * fit, with the refit and without, and reports how far the fit strays
+ * from the function in pixels. the longest input is a sine series cut to
+ * what the prompt takes.
+ */
+int run_bench_cheb(int rounds)
+{
+    char series[256] = "";
+    for (int k = 1;; ++k)
     {
-        double world_y = graph_func(to_world_x(x));
-        world_y = S_HEIGHT - world_y;
-        world_y -= S_HEIGHT / 2;
+        char term[32];
+        int n = snprintf(term, sizeof(term), "%ssin(%d*x)/%d", k > 1 ? "+" : "", k, k);
+        if (strlen(series) + n >= sizeof(series))
+            break;
+        strcat(series, term);
+    }
+    const char *expressions[] = {"sin(x)/x", "exp(-x*x)*cos(10*x)", "log(1+x*x)*atan(x)",
+                                 "tan(x)", series};
 
-        //int y1 = to_screen_y(last_y);
-        int y2 = to_screen_y(world_y);
+    struct plot_view view = {{0, 0}, {0, 0}, 100, S_WIDTH, S_HEIGHT};
+    unsigned int *pixels = malloc(S_WIDTH * S_HEIGHT * sizeof(*pixels));
+    if (!pixels)
+    {
+        printf("Out of memory for the benchmark\n");
+        return EXIT_FAILURE;
+    }
 
-        if (y2 < 0 || y2 >= S_HEIGHT) continue;
-        pixels[y2 * S_WIDTH + (int)x] = 0xffffffff;
+    int status = EXIT_SUCCESS;
+    for (size_t e = 0; e < sizeof(expressions) / sizeof(expressions[0]); ++e)
+    {
+        struct jit_funcs bench_funcs;
+        struct jit_module *module = jit_build(expressions[e], &bench_funcs);
+        if (!module)
+        {
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        struct axes_cache axes = {0};
+        struct cheb_cache cheb = {0};
+        double direct = 0, refit = 0, fitted = 0;
+        for (int i = 0; i < rounds; ++i)
+        {
+            Uint64 start = SDL_GetPerformanceCounter();
+            plot_render(&bench_funcs, &view, &axes, NULL, pixels);
+            direct += elapsed_ms(start);
 
-        // y1 = clamp(y1, 0, S_HEIGHT - 1);
-        // y2 = clamp(y2, 0, S_HEIGHT - 1);
+            cheb_reset(&cheb);
+            start = SDL_GetPerformanceCounter();
+            plot_render(&bench_funcs, &view, &axes, &cheb, pixels);
+            refit += elapsed_ms(start);
+
+            start = SDL_GetPerformanceCounter();
+            plot_render(&bench_funcs, &view, &axes, &cheb, pixels);
+            fitted += elapsed_ms(start);
+        }
+
+        /* in pixels, wherever the function is finite */
+        double worst = 0;
+        int exact = 0;
+        for (int i = 0; i < cheb.count; ++i)
+            exact += cheb.segments[i].exact;
+        int total = S_WIDTH * CHEB_CHECKS_PER_PIXEL;
+        double xs[EVAL_BATCH], want[EVAL_BATCH], got[EVAL_BATCH];
+        for (int start = 0; start < total; start += EVAL_BATCH)
+        {
+            int n = total - start < EVAL_BATCH ? total - start : EVAL_BATCH;
+            for (int i = 0; i < n; ++i)
+                xs[i] = ((double)(start + i) / CHEB_CHECKS_PER_PIXEL - S_WIDTH / 2.0) / view.scale;
+            eval_batch(&bench_funcs, EVAL_DOUBLE, xs, want, n);
+            cheb_eval(&cheb, &bench_funcs, EVAL_DOUBLE, xs, got, n);
+            for (int i = 0; i < n; ++i)
+            {
+                double off = fabs(got[i] - want[i]) * view.scale;
+                if (isfinite(off) && off > worst)
+                    worst = off;
+            }
+        }
 
-        // int step = (y2 < y1) ? -1 : 1;
-        // int y = y1;
-        // for (int i = 0; i < abs(y1 - y2) + 1; ++i)
-        // {
-        //     unsigned int pos = y * S_WIDTH + (unsigned int)x;
-        //     pixels[pos] = 0xffffffff;
-        //     y += step;
-        // }
+        printf("cheb %s: direct %.3f ms, refit %.3f ms, fitted %.3f ms, %d segments (%d exact), "
+               "max error %.3f px over %d samples\n",
+               expressions[e], direct / rounds, refit / rounds, fitted / rounds,
+               cheb.count, exact, worst, total);
 
-        // last_y = world_y;
+        free(cheb.segments);
+        jit_release(module);
     }
-    
-    SDL_UnlockSurface(surface);
+
+    free(pixels);
+    return status;
 }
 
 int main(int argc, char *argv[])
 {
-    (void)argc;
-    (void)argv;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    const char *timings_path = NULL;
+    const char *batch_path = NULL;
+    int bench_rounds = 0;
+    int cheb_rounds = 0;
 
-    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_path = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (!strcmp(argv[i], "--timings") && i + 1 < argc)
+            timings_path = argv[++i];
+        else if (!strcmp(argv[i], "--batch") && i + 1 < argc)
+            batch_path = argv[++i];
+        else if (!strcmp(argv[i], "--bench-compile") && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            bench_rounds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--bench-cheb") && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            cheb_rounds = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--record file] [--replay file [--timings file.csv]] [--batch manifest]"
+                            " [--bench-compile rounds] [--bench-cheb rounds]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* replays, batches and benchmarks are headless and need no video subsystem */
+    bool headless = replay_path || batch_path || bench_rounds || cheb_rounds;
+    if (SDL_Init(headless ? 0 : SDL_INIT_VIDEO) != 0)
     {
         fprintf(stderr, "Error, could not init SDL: %s\n", SDL_GetError());
         return EXIT_FAILURE;
     }
 
+    /* linear function by default */
+    funcs.graph_func = &f;
+    funcs.graph_func_d = &f_d;
+    funcs.graph_func_batch = &f_batch;
+    funcs.graph_func_batch_f = &f_batch_f;
+
+    watchdog_init();
+    pool_init(0);
+    axes_init();
+
+    if (headless)
+    {
+        int status;
+        if (replay_path)
+            status = run_replay(replay_path, timings_path);
+        else if (batch_path)
+            status = batch_run(batch_path);
+        else if (bench_rounds)
+            status = run_bench_compile(bench_rounds);
+        else
+            status = run_bench_cheb(cheb_rounds);
+        /* a replay may leave a stuck render behind, and pool threads with it */
+        if (watchdog_quit())
+            pool_quit();
+        jit_free();
+        SDL_Quit();
+        return status;
+    }
+
     SDL_Window *window = SDL_CreateWindow("graphs",
                                           SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
                                           S_WIDTH, S_HEIGHT, SDL_WINDOW_SHOWN);
@@ -153,107 +975,75 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* linear function by default */
-    graph_func = &f;
-
-    TCCState *s = tcc_new();
-    if (!s)
+    if (record_path && !record_start(record_path))
     {
-        printf("Can't create a TCC context\n");
-        return 1;
+        SDL_DestroyWindow(window);
+        return EXIT_FAILURE;
     }
-    tcc_set_output_type(s, TCC_OUTPUT_MEMORY);
+
+    next_frame = new_frame();
+    struct frame_clock clock;
+    clock_start(&clock, window);
+    char title[64] = "graphs";
 
     bool quit = false;
-    bool mouse_down = false;
-    Sint32 mouse_x, mouse_y;
     SDL_Event e;
     while (!quit)
     {
         while (SDL_PollEvent(&e))
         {
-            switch (e.type)
-            {
-            case SDL_QUIT:
+            record_event(frame, SDL_GetTicks(), &e);
+            if (!handle_event(&e))
                 quit = true;
-                break;
-            case SDL_MOUSEBUTTONDOWN:
-                mouse_down = true;
-                break;
-            case SDL_MOUSEBUTTONUP:
-                mouse_down = false;
-                break;
-            case SDL_MOUSEWHEEL:
-                double x_before_scale = to_world_x(mouse_x);
-                double y_before_scale = to_world_y(mouse_y);
-
-                if (e.wheel.y > 0)
-                    scale *= STEP_UP;
-                else
-                    scale *= STEP_DOWN;
-
-                double x_after_scale = to_world_x(mouse_x);
-                double y_after_scale = to_world_y(mouse_y);
+        }
 
-                x_offset += x_before_scale - x_after_scale;
-                y_offset += y_before_scale - y_after_scale;
-                break;
-            case SDL_MOUSEMOTION:
-                mouse_x = e.motion.x;
-                mouse_y = e.motion.y;
-                if (mouse_down)
-                {
-                    x_offset -= e.motion.xrel / scale;
-                    y_offset -= e.motion.yrel / scale;
-                }
-                break;
-            case SDL_KEYDOWN:
-                switch (e.key.keysym.scancode)
-                {
-                case SDL_SCANCODE_RETURN:
-                    char scan_buf[256];
-                    char func_buf[256];
-
-                    fflush(stdin);
-                    printf("f(x) = ");
-                    scanf("%s", scan_buf);
-
-                    sprintf(func_buf, graph_func_template, scan_buf);
-
-                    tcc_delete(s);
-                    s = tcc_new();
-                    if (!s)
-                    {
-                        printf("Can't create a TCC context\n");
-                        return 1;
-                    }
-                    tcc_set_output_type(s, TCC_OUTPUT_MEMORY);
-
-                    if (tcc_compile_string(s, func_buf) > 0)
-                    {
-                        printf("Compilation error.\n");
-                        break;
-                    }
-
-                    tcc_relocate(s, TCC_RELOCATE_AUTO);
-
-                    graph_func = tcc_get_symbol(s, "graph_func");
-
-                    break;
-                default:
-                }
-                break;
-            default:
+        /* the window keeps the last good frame while the function is too slow */
+        bool animated = false;
+        if (!too_slow)
+        {
+            next_frame->job = snapshot(clock_time(&clock));
+            SDL_AtomicSet(&next_frame->done, 0);
+            animated = next_frame->job.animated;
+            if (watchdog_run(render_task, next_frame, FRAME_BUDGET_MS) == WATCHDOG_DONE)
+                present(next_frame->canvas, surface);
+            else
+            {
+                too_slow = true;
+                printf("Too slow to draw, enter another expression.\n");
             }
         }
 
-        render_graph(surface);
+        char next_title[64] = "graphs";
+        if (too_slow)
+            snprintf(next_title, sizeof(next_title), "graphs - too slow");
+        else if (animated)
+            snprintf(next_title, sizeof(next_title), "graphs - %u frames dropped", clock.dropped);
+        if (strcmp(title, next_title))
+        {
+            strcpy(title, next_title);
+            SDL_SetWindowTitle(window, title);
+        }
+
+        reap_strays();
         SDL_UpdateWindowSurface(window);
+        clock_wait(&clock, animated);
+        ++frame;
     }
 
-    tcc_delete(s);
+    if (clock.dropped)
+        printf("animation: %u frames dropped at %.0f Hz\n", clock.dropped, clock.rate);
+
+    record_stop();
+    if (watchdog_quit())
+    {
+        pool_quit();
+        free_frame(next_frame);
+    }
+    /* whatever a stray still runs keeps its reference */
+    reap_strays();
+    jit_free();
     SDL_DestroyWindow(window);
     SDL_Quit();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "plot.h"
+#include "watchdog.h"
+#include "pool.h"
+
+/* curve samples per pixel column */
+#define SAMPLES_PER_PIXEL 200
+/* columns per pool task */
+#define CHUNK_COLUMNS 8
+
+#define AXIS_COLOR 0x737373ff
+#define CURVE_COLOR 0xffffffff
+
+struct curve_job
+{
+    const struct jit_funcs *funcs;
+    const struct plot_view *view;
+    unsigned int *pixels;
+    enum eval_precision precision;
+    const struct cheb_cache *approx;
+    double cx, cy;
+};
+
+/* samples the curve over CHUNK_COLUMNS whole columns, so no two chunks share a pixel */
+static void curve_chunk(void *ctx, int index)
+{
+    const struct curve_job *job = ctx;
+    const struct plot_view *view = job->view;
+    int width = view->width, height = view->height;
+    double scale = view->scale;
+
+    int first = index * CHUNK_COLUMNS * SAMPLES_PER_PIXEL;
+    int last = (index + 1) * CHUNK_COLUMNS;
+    last = (last < width ? last : width) * SAMPLES_PER_PIXEL;
+
+    /* results are brought relative to the centre before scaling */
+    dd y_shift = {-view->center_y.hi, -view->center_y.lo};
+    double xs[EVAL_BATCH], ys[EVAL_BATCH];
+
+    for (int start = first; start < last && !watchdog_cancelled(); start += EVAL_BATCH)
+    {
+        int n = last - start < EVAL_BATCH ? last - start : EVAL_BATCH;
+        if (job->precision == EVAL_DD)
+        {
+            for (int i = 0; i < n; ++i)
+                xs[i] = ((double)(start + i) / SAMPLES_PER_PIXEL - width / 2.0) / scale;
+            eval_batch_dd(job->funcs, view->center_x, xs, y_shift, ys, n);
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+                xs[i] = job->cx + ((double)(start + i) / SAMPLES_PER_PIXEL - width / 2.0) / scale;
+            if (job->approx)
+                cheb_eval(job->approx, job->funcs, job->precision, xs, ys, n);
+            else
+                eval_batch(job->funcs, job->precision, xs, ys, n);
+            for (int i = 0; i < n; ++i)
+                ys[i] -= job->cy;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            double sy = height / 2.0 - ys[i] * scale;
+            if (!(sy >= 0 && sy < height))
+                continue;
+            job->pixels[(int)sy * width + (start + i) / SAMPLES_PER_PIXEL] = CURVE_COLOR;
+        }
+    }
+}
+
+enum eval_precision plot_render(const struct jit_funcs *funcs, const struct plot_view *view,
+                                struct axes_cache *cache, struct cheb_cache *approx, unsigned int *pixels)
+{
+    int width = view->width, height = view->height;
+    double scale = view->scale;
+    double cx = dd_to_double(view->center_x);
+    double cy = dd_to_double(view->center_y);
+
+    memset(pixels, 0, (size_t)width * height * sizeof(*pixels));
+
+    /* where world (0, 0) lands */
+    double origin_x = width / 2.0 - cx * scale;
+    double origin_y = height / 2.0 + cy * scale;
+
+    axes_render(cache, pixels, width, height, origin_x, origin_y, scale);
+
+    /* horizontal graph line */
+    if (origin_y >= 0 && origin_y < height)
+    {
+        unsigned int *row = &pixels[(int)origin_y * width];
+        for (int x = 0; x < width; ++x)
+            row[x] = AXIS_COLOR;
+    }
+
+    /* vertical graph line */
+    if (origin_x >= 0 && origin_x < width)
+    {
+        for (int y = 0; y < height; ++y)
+            pixels[y * width + (int)origin_x] = AXIS_COLOR;
+    }
+
+    double half_w = width / 2.0 / scale, half_h = height / 2.0 / scale;
+    enum eval_precision precision = eval_choose(funcs, cx - half_w, cx + half_w,
+                                                cy - half_h, cy + half_h, scale);
+
+    /* deep zoom needs every digit, a fit in double would throw them away */
+    if (approx && precision != EVAL_DD)
+    {
+        /* a refit costs no more than drawing the view directly once */
+        cheb_update(approx, funcs, cx - half_w, cx + half_w, scale, (long)width * SAMPLES_PER_PIXEL);
+    }
+    else
+        approx = NULL;
+
+    struct curve_job job = {funcs, view, pixels, precision, approx, cx, cy};
+    int chunks = (width + CHUNK_COLUMNS - 1) / CHUNK_COLUMNS;
+    pool_for(chunks, curve_chunk, &job);
+
+    return precision;
+}
@@ -0,0 +1,34 @@
+#ifndef PLOT_H
+#define PLOT_H
+
+#include "jit.h"
+#include "dd.h"
+#include "axes.h"
+#include "eval.h"
+#include "cheb.h"
+
+/*
+ * a view of the graph: the world point at the centre of the image, how
+ * many pixels one world unit spans and the image size. the centre is a
+ * double-double so deep zoom views can be described exactly.
+ */
+struct plot_view
+{
+    dd center_x, center_y;
+    double scale;
+    int width, height;
+};
+
+/*
+ * draws background, grid, axes and the curve of funcs into pixels, which
+ * holds width * height RGBA8888 values. only touches pixels and cache, so
+ * different views can be rendered on different threads at once. the curve
+ * is sampled on the thread pool, or serially when called from a pool task.
+ * with approx the curve goes through a chebyshev fit kept there, refitted
+ * only when the view needs it, NULL evaluates funcs directly. returns the
+ * precision the curve was evaluated in.
+ */
+enum eval_precision plot_render(const struct jit_funcs *funcs, const struct plot_view *view,
+                                struct axes_cache *cache, struct cheb_cache *approx, unsigned int *pixels);
+
+#endif /* PLOT_H */
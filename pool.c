@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL2/SDL.h>
+
+#include "pool.h"
+#include "watchdog.h"
+
+#define POOL_MAX_THREADS 64
+
+static SDL_Thread *workers[POOL_MAX_THREADS];
+static int worker_count = 0;
+
+static SDL_mutex *lock;
+static SDL_cond *wake;
+static SDL_cond *finished;
+
+/* one pool_for, on the stack of the thread that issued it */
+struct pool_job
+{
+    pool_task fn;
+    void *ctx;
+    int count;
+    void *scope;
+    SDL_atomic_t next;
+    SDL_atomic_t left;
+    int active; /* guarded by lock */
+};
+
+/* guarded by lock */
+static unsigned int generation = 0;
+static bool quitting = false;
+/* the job sleeping workers join, NULL when there is none */
+static struct pool_job *current;
+
+/* worker index + 1 as a pointer, unset (NULL) on every other thread */
+static SDL_TLSID worker_id;
+
+static void run_tasks(struct pool_job *job)
+{
+    int i;
+    while ((i = SDL_AtomicAdd(&job->next, 1)) < job->count)
+    {
+        job->fn(job->ctx, i);
+        if (SDL_AtomicAdd(&job->left, -1) == 1)
+        {
+            SDL_LockMutex(lock);
+            SDL_CondBroadcast(finished);
+            SDL_UnlockMutex(lock);
+        }
+    }
+}
+
+static int worker_main(void *data)
+{
+    SDL_TLSSet(worker_id, data, NULL);
+
+    SDL_LockMutex(lock);
+    unsigned int seen = generation;
+    for (;;)
+    {
+        while (generation == seen && !quitting)
+            SDL_CondWait(wake, lock);
+        if (quitting)
+            break;
+
+        seen = generation;
+        struct pool_job *job = current;
+        if (!job)
+            continue;
+        ++job->active;
+        SDL_UnlockMutex(lock);
+
+        /* cancellation follows the thread that issued the pool_for */
+        watchdog_enter(job->scope);
+        run_tasks(job);
+        watchdog_enter(NULL);
+
+        SDL_LockMutex(lock);
+        if (--job->active == 0)
+            SDL_CondBroadcast(finished);
+    }
+    SDL_UnlockMutex(lock);
+
+    return 0;
+}
+
+void pool_init(int threads)
+{
+    if (threads <= 0)
+        threads = SDL_GetCPUCount();
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    lock = SDL_CreateMutex();
+    wake = SDL_CreateCond();
+    finished = SDL_CreateCond();
+    worker_id = SDL_TLSCreate();
+
+    /* the thread calling pool_for is the last worker */
+    for (int i = 0; i < threads - 1; ++i)
+    {
+        workers[worker_count] = SDL_CreateThread(worker_main, "pool", (void *)(intptr_t)(worker_count + 1));
+        if (workers[worker_count] == NULL)
+        {
+            printf("error in SDL_CreateThread: %s\n", SDL_GetError());
+            break;
+        }
+        ++worker_count;
+    }
+}
+
+void pool_quit(void)
+{
+    SDL_LockMutex(lock);
+    quitting = true;
+    SDL_CondBroadcast(wake);
+    SDL_UnlockMutex(lock);
+
+    for (int i = 0; i < worker_count; ++i)
+        SDL_WaitThread(workers[i], NULL);
+    worker_count = 0;
+
+    SDL_DestroyCond(finished);
+    SDL_DestroyCond(wake);
+    SDL_DestroyMutex(lock);
+}
+
+int pool_size(void)
+{
+    return worker_count + 1;
+}
+
+int pool_worker(void)
+{
+    return (int)(intptr_t)SDL_TLSGet(worker_id);
+}
+
+void pool_for(int count, pool_task fn, void *ctx)
+{
+    if (count <= 0)
+        return;
+
+    struct pool_job job = {.fn = fn, .ctx = ctx, .count = count, .scope = watchdog_scope()};
+    SDL_AtomicSet(&job.next, 0);
+    SDL_AtomicSet(&job.left, count);
+
+    bool parallel = worker_count > 0 && count > 1;
+    if (parallel)
+    {
+        SDL_LockMutex(lock);
+        /*
+         * a job whose render was abandoned never gives the workers back
+         * by itself. it is left to the threads stuck in it, everyone
+         * else moves on to the new one.
+         */
+        if (current && watchdog_abandoned(current->scope))
+        {
+            printf("pool: left an abandoned job behind, %d of %d threads are stuck in it\n",
+                   current->active, worker_count);
+            current = NULL;
+        }
+        parallel = !current;
+        if (parallel)
+        {
+            current = &job;
+            ++generation;
+            SDL_CondBroadcast(wake);
+        }
+        SDL_UnlockMutex(lock);
+    }
+
+    run_tasks(&job);
+    if (!parallel)
+        return;
+
+    SDL_LockMutex(lock);
+    while (SDL_AtomicGet(&job.left) > 0 || job.active > 0)
+        SDL_CondWait(finished, lock);
+    if (current == &job)
+        current = NULL;
+    SDL_UnlockMutex(lock);
+}
@@ -0,0 +1,33 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * a fixed set of SDL worker threads for data-parallel loops.
+ *
+ * pool_for runs fn(ctx, i) for every i in [0, count) and returns once all
+ * of them finished, the calling thread takes part in the work. a pool_for
+ * issued while another one is running (e.g. from inside a task) runs
+ * serially on the calling thread instead of deadlocking, unless the other
+ * one belongs to an abandoned render: that one keeps only the threads
+ * stuck in it and the rest of the pool goes to the new one.
+ */
+
+typedef void (*pool_task)(void *ctx, int index);
+
+/* threads <= 0 picks one worker per logical cpu */
+void pool_init(int threads);
+void pool_quit(void);
+
+/* number of threads working on a pool_for, including the caller */
+int pool_size(void);
+
+/*
+ * which thread a task runs on: 1 to pool_size() - 1 for the workers, 0 for
+ * any thread outside the pool, including the one calling pool_for. lets
+ * tasks keep per-thread scratch in an array of pool_size() slots.
+ */
+int pool_worker(void);
+
+void pool_for(int count, pool_task fn, void *ctx);
+
+#endif /* POOL_H */
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "record.h"
+
+/*
+ * file layout: the magic, then one entry after another as
+ *     frame delta, time delta, kind, payload
+ * where all integers are LEB128 varints (signed ones zigzag encoded), so a
+ * typical mouse motion costs 7 bytes.
+ */
+static const char magic[] = "GRREC1";
+
+static FILE *out = NULL;
+static unsigned int out_frame, out_time;
+static unsigned int in_frame, in_time;
+
+static void put_uvar(unsigned int v)
+{
+    while (v >= 0x80)
+    {
+        fputc((v & 0x7f) | 0x80, out);
+        v >>= 7;
+    }
+    fputc(v, out);
+}
+
+static void put_svar(int v)
+{
+    put_uvar(((unsigned int)v << 1) ^ (unsigned int)(v >> 31));
+}
+
+static bool get_uvar(FILE *fp, unsigned int *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        int c = fgetc(fp);
+        if (c == EOF)
+            return false;
+        *v |= (unsigned int)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool get_svar(FILE *fp, int *v)
+{
+    unsigned int u;
+    if (!get_uvar(fp, &u))
+        return false;
+    *v = (int)(u >> 1) ^ -(int)(u & 1);
+    return true;
+}
+
+bool record_start(const char *path)
+{
+    out = fopen(path, "wb");
+    if (!out)
+    {
+        printf("Can't open %s for recording\n", path);
+        return false;
+    }
+    fwrite(magic, 1, sizeof(magic) - 1, out);
+    out_frame = 0;
+    out_time = SDL_GetTicks();
+    return true;
+}
+
+void record_stop(void)
+{
+    if (out)
+        fclose(out);
+    out = NULL;
+}
+
+static void put_header(unsigned int frame, unsigned int time_ms, enum record_kind kind)
+{
+    put_uvar(frame - out_frame);
+    put_uvar(time_ms - out_time);
+    fputc(kind, out);
+    out_frame = frame;
+    out_time = time_ms;
+}
+
+void record_event(unsigned int frame, unsigned int time_ms, const SDL_Event *e)
+{
+    if (!out)
+        return;
+
+    switch (e->type)
+    {
+    case SDL_QUIT:
+        put_header(frame, time_ms, REC_QUIT);
+        break;
+    case SDL_MOUSEBUTTONDOWN:
+        put_header(frame, time_ms, REC_MOUSE_DOWN);
+        break;
+    case SDL_MOUSEBUTTONUP:
+        put_header(frame, time_ms, REC_MOUSE_UP);
+        break;
+    case SDL_MOUSEWHEEL:
+        put_header(frame, time_ms, REC_WHEEL);
+        put_svar(e->wheel.y);
+        break;
+    case SDL_MOUSEMOTION:
+        put_header(frame, time_ms, REC_MOTION);
+        put_svar(e->motion.x);
+        put_svar(e->motion.y);
+        put_svar(e->motion.xrel);
+        put_svar(e->motion.yrel);
+        break;
+    case SDL_KEYDOWN:
+        /* the expression prompt is recorded as its result instead, exports change nothing */
+        if (e->key.keysym.scancode == SDL_SCANCODE_RETURN || e->key.keysym.scancode == SDL_SCANCODE_E)
+            break;
+        put_header(frame, time_ms, REC_KEY);
+        put_uvar(e->key.keysym.scancode);
+        break;
+    default:
+        break;
+    }
+}
+
+void record_expression(unsigned int frame, unsigned int time_ms, const char *expr)
+{
+    if (!out)
+        return;
+
+    size_t len = strlen(expr);
+    if (len >= RECORD_EXPR_LEN)
+        len = RECORD_EXPR_LEN - 1;
+
+    put_header(frame, time_ms, REC_EXPR);
+    put_uvar(len);
+    fwrite(expr, 1, len, out);
+}
+
+FILE *replay_open(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        printf("Can't open %s for replay\n", path);
+        return NULL;
+    }
+
+    char header[sizeof(magic) - 1];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header) || memcmp(header, magic, sizeof(header)))
+    {
+        printf("%s is not a recording\n", path);
+        fclose(fp);
+        return NULL;
+    }
+
+    in_frame = 0;
+    in_time = 0;
+    return fp;
+}
+
+bool replay_read(FILE *fp, struct record_entry *entry)
+{
+    unsigned int frame_delta, time_delta;
+    if (!get_uvar(fp, &frame_delta) || !get_uvar(fp, &time_delta))
+        return false;
+    int kind = fgetc(fp);
+    if (kind == EOF)
+        return false;
+
+    in_frame += frame_delta;
+    in_time += time_delta;
+    entry->frame = in_frame;
+    entry->time_ms = in_time;
+    entry->kind = kind;
+    memset(&entry->event, 0, sizeof(entry->event));
+
+    SDL_Event *e = &entry->event;
+    unsigned int len, scancode;
+    bool ok = true;
+
+    switch (entry->kind)
+    {
+    case REC_QUIT:
+        e->type = SDL_QUIT;
+        break;
+    case REC_MOUSE_DOWN:
+        e->type = SDL_MOUSEBUTTONDOWN;
+        break;
+    case REC_MOUSE_UP:
+        e->type = SDL_MOUSEBUTTONUP;
+        break;
+    case REC_WHEEL:
+        e->type = SDL_MOUSEWHEEL;
+        ok = get_svar(fp, &e->wheel.y);
+        break;
+    case REC_MOTION:
+        e->type = SDL_MOUSEMOTION;
+        ok = get_svar(fp, &e->motion.x) && get_svar(fp, &e->motion.y) &&
+             get_svar(fp, &e->motion.xrel) && get_svar(fp, &e->motion.yrel);
+        break;
+    case REC_KEY:
+        e->type = SDL_KEYDOWN;
+        ok = get_uvar(fp, &scancode);
+        e->key.keysym.scancode = scancode;
+        break;
+    case REC_EXPR:
+        ok = get_uvar(fp, &len) && len < RECORD_EXPR_LEN &&
+             fread(entry->expr, 1, len, fp) == len;
+        if (ok)
+            entry->expr[len] = '\0';
+        break;
+    default:
+        ok = false;
+    }
+
+    return ok;
+}
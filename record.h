@@ -0,0 +1,49 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <SDL2/SDL.h>
+
+#define RECORD_EXPR_LEN 256
+
+/*
+ * session recordings: the input events main reacts to and every entered
+ * expression, each tagged with the frame it arrived in and the ms since
+ * the recording started. replays are driven by the frame numbers only, so
+ * they do not depend on how fast the recording machine was.
+ */
+
+enum record_kind
+{
+    REC_QUIT,
+    REC_MOUSE_DOWN,
+    REC_MOUSE_UP,
+    REC_WHEEL,
+    REC_MOTION,
+    REC_KEY,
+    REC_EXPR,
+};
+
+struct record_entry
+{
+    unsigned int frame;
+    unsigned int time_ms;
+    enum record_kind kind;
+    SDL_Event event;              /* everything but REC_EXPR */
+    char expr[RECORD_EXPR_LEN];   /* REC_EXPR */
+};
+
+bool record_start(const char *path);
+void record_stop(void);
+
+/* events main does not handle are skipped */
+void record_event(unsigned int frame, unsigned int time_ms, const SDL_Event *e);
+void record_expression(unsigned int frame, unsigned int time_ms, const char *expr);
+
+FILE *replay_open(const char *path);
+/* false at the end of the file or on a damaged entry */
+bool replay_read(FILE *fp, struct record_entry *out);
+
+#endif /* RECORD_H */
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <SDL2/SDL.h>
+
+#include "watchdog.h"
+
+/* time a cancelled frame gets to reach the next batch boundary */
+#define GRACE_MS 100
+/* cancel flag of an abandoned runner, no run resets it */
+#define ABANDONED 2
+
+struct runner
+{
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    SDL_cond *done;
+    /* 1 when the job runs out of time, ABANDONED for good once the runner is */
+    SDL_atomic_t cancel;
+
+    /* guarded by lock */
+    watchdog_job fn;
+    void *ctx;
+    bool has_job;
+    bool quitting;
+    bool abandoned;
+};
+
+static struct runner *runner = NULL;
+/* the cancel flag of the run a thread works for, NULL outside any */
+static SDL_TLSID scope_id;
+/* abandoned runners that haven't returned yet */
+static SDL_atomic_t strays;
+
+static void runner_free(struct runner *r)
+{
+    SDL_DestroyCond(r->done);
+    SDL_DestroyCond(r->wake);
+    SDL_DestroyMutex(r->lock);
+    free(r);
+}
+
+static int runner_main(void *data)
+{
+    struct runner *r = data;
+    SDL_TLSSet(scope_id, &r->cancel, NULL);
+
+    SDL_LockMutex(r->lock);
+    for (;;)
+    {
+        while (!r->has_job && !r->quitting)
+            SDL_CondWait(r->wake, r->lock);
+        if (!r->has_job)
+            break;
+
+        watchdog_job fn = r->fn;
+        void *ctx = r->ctx;
+        SDL_UnlockMutex(r->lock);
+
+        fn(ctx);
+
+        SDL_LockMutex(r->lock);
+        r->has_job = false;
+        SDL_CondSignal(r->done);
+    }
+    bool abandoned = r->abandoned;
+    SDL_UnlockMutex(r->lock);
+
+    /* nobody else holds an abandoned runner any more */
+    if (abandoned)
+    {
+        runner_free(r);
+        SDL_AtomicAdd(&strays, -1);
+    }
+    return 0;
+}
+
+static struct runner *runner_new(void)
+{
+    struct runner *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+
+    r->lock = SDL_CreateMutex();
+    r->wake = SDL_CreateCond();
+    r->done = SDL_CreateCond();
+    r->thread = SDL_CreateThread(runner_main, "render", r);
+    if (r->thread == NULL)
+    {
+        printf("error in SDL_CreateThread: %s\n", SDL_GetError());
+        runner_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+/* waits for the job until deadline (SDL_GetTicks), true if it finished */
+static bool wait_until(struct runner *r, Uint32 deadline)
+{
+    while (r->has_job)
+    {
+        Sint32 left = (Sint32)(deadline - SDL_GetTicks());
+        if (left <= 0 || SDL_CondWaitTimeout(r->done, r->lock, left) == SDL_MUTEX_TIMEDOUT)
+            break;
+    }
+    return !r->has_job;
+}
+
+void watchdog_init(void)
+{
+    scope_id = SDL_TLSCreate();
+}
+
+enum watchdog_result watchdog_run(watchdog_job fn, void *ctx, unsigned int budget_ms)
+{
+    if (!runner)
+        runner = runner_new();
+    if (!runner)
+    {
+        /* no thread to spare, no protection either */
+        fn(ctx);
+        return WATCHDOG_DONE;
+    }
+
+    SDL_LockMutex(runner->lock);
+    if (runner->has_job)
+    {
+        SDL_UnlockMutex(runner->lock);
+        return WATCHDOG_STUCK;
+    }
+
+    SDL_AtomicSet(&runner->cancel, 0);
+    runner->fn = fn;
+    runner->ctx = ctx;
+    runner->has_job = true;
+    SDL_CondSignal(runner->wake);
+
+    Uint32 start = SDL_GetTicks();
+    enum watchdog_result result = WATCHDOG_DONE;
+    if (!wait_until(runner, start + budget_ms))
+    {
+        SDL_AtomicSet(&runner->cancel, 1);
+        result = wait_until(runner, SDL_GetTicks() + GRACE_MS) ? WATCHDOG_CANCELLED : WATCHDOG_STUCK;
+    }
+    SDL_UnlockMutex(runner->lock);
+
+    return result;
+}
+
+bool watchdog_busy(void)
+{
+    if (!runner)
+        return false;
+
+    SDL_LockMutex(runner->lock);
+    bool busy = runner->has_job;
+    SDL_UnlockMutex(runner->lock);
+    return busy;
+}
+
+void watchdog_abandon(void)
+{
+    if (!runner)
+        return;
+
+    /* the runner may free itself as soon as it is unlocked */
+    SDL_Thread *thread = runner->thread;
+    SDL_AtomicAdd(&strays, 1);
+    /* whenever the job gets control back it stops, no later run resets this */
+    SDL_AtomicSet(&runner->cancel, ABANDONED);
+    SDL_LockMutex(runner->lock);
+    runner->abandoned = true;
+    runner->quitting = true;
+    SDL_CondSignal(runner->wake);
+    SDL_UnlockMutex(runner->lock);
+
+    SDL_DetachThread(thread);
+    runner = NULL;
+}
+
+bool watchdog_cancelled(void)
+{
+    SDL_atomic_t *flag = scope_id ? SDL_TLSGet(scope_id) : NULL;
+    return flag && SDL_AtomicGet(flag) != 0;
+}
+
+bool watchdog_abandoned(void *scope)
+{
+    return scope && SDL_AtomicGet(scope) == ABANDONED;
+}
+
+void *watchdog_scope(void)
+{
+    return scope_id ? SDL_TLSGet(scope_id) : NULL;
+}
+
+void watchdog_enter(void *scope)
+{
+    if (scope_id)
+        SDL_TLSSet(scope_id, scope, NULL);
+}
+
+bool watchdog_quit(void)
+{
+    /* a thread still stuck in compiled code can't be joined */
+    if (watchdog_busy())
+        watchdog_abandon();
+
+    if (runner)
+    {
+        SDL_LockMutex(runner->lock);
+        runner->quitting = true;
+        SDL_CondSignal(runner->wake);
+        SDL_UnlockMutex(runner->lock);
+
+        SDL_WaitThread(runner->thread, NULL);
+        runner_free(runner);
+        runner = NULL;
+    }
+    return SDL_AtomicGet(&strays) == 0;
+}
@@ -0,0 +1,66 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdbool.h>
+
+/*
+ * runs frames on a render thread under a deadline, so the event loop keeps
+ * going whatever the compiled code does.
+ *
+ * a frame over budget gets the cancel flag of its run raised, which
+ * evaluation loops poll between batches. every render thread has a flag
+ * of its own, so a new run never clears the one of a thread left behind.
+ * code that never reaches a batch boundary (an endless loop inside the
+ * expression) can't be stopped from outside, the thread is then reported
+ * stuck and can be left behind for a fresh one.
+ */
+
+typedef void (*watchdog_job)(void *ctx);
+
+/* call once at startup, before the thread pool starts */
+void watchdog_init(void);
+
+enum watchdog_result
+{
+    WATCHDOG_DONE,      /* finished within budget */
+    WATCHDOG_CANCELLED, /* stopped at a batch boundary, the output is partial */
+    WATCHDOG_STUCK,     /* still running, the render thread stays busy until it returns */
+};
+
+/* runs fn(ctx) on the render thread and waits at most budget_ms for it */
+enum watchdog_result watchdog_run(watchdog_job fn, void *ctx, unsigned int budget_ms);
+
+/* true while a stuck job is still running */
+bool watchdog_busy(void);
+
+/*
+ * leaves a busy render thread to itself, the next run starts a new one.
+ * whatever the stuck job uses (its ctx, the code it runs) must stay alive.
+ */
+void watchdog_abandon(void);
+
+/*
+ * polled by evaluation between batches, true once the run the calling
+ * thread works for ran out of time or was abandoned. always false
+ * outside a run.
+ */
+bool watchdog_cancelled(void);
+
+/*
+ * the run the calling thread works for, NULL outside one. pool workers
+ * enter the scope of whoever issued the pool_for they help with, and
+ * leave it again with NULL.
+ */
+void *watchdog_scope(void);
+void watchdog_enter(void *scope);
+
+/* whether scope belongs to a run that was abandoned, so it will never be waited for */
+bool watchdog_abandoned(void *scope);
+
+/*
+ * stops the render thread. false if a stuck one is still running, pool
+ * workers may then be stuck too and shouldn't be waited for.
+ */
+bool watchdog_quit(void);
+
+#endif /* WATCHDOG_H */